@@ -22,7 +22,7 @@ import siqadconn
 class SiQADInterface:
     '''Interface with SiQAD using SiQADConnector and command line arguments.'''
 
-    dbs = []        # list of tuples of floats containing DB locations (x, y)
+    dbs = []        # (n, 2) array of floats containing DB locations (x, y)
 
     def __init__(self):
         '''Initialize the interface.'''
@@ -65,15 +65,20 @@ class SiQADInterface:
         '''Initialize problem using user parameters and DB design retrieved from 
         SiQADConnector.'''
 
-        # TODO the following loop gets DBs that are already in aggregates, see 
-        # if there's a flag to prevent this or other ways of reading DBs such as 
-        # directly accessing the items data structure.
-        for db in self.sqconn.dbCollection():
-            self.dbs.append((db.x, db.y))
-
-        # plugin parameters
-        self.d_inner_max = float(self.sqconn.getParameter('max_dbp_inner_distance'))
-        self.d_inner_min = float(self.sqconn.getParameter('min_dbp_inner_distance'))
+        # TODO this gets DBs that are already in aggregates, see if there's a 
+        # flag to prevent this.
+        # DB locations are read straight from the connector's DB arrays 
+        # without creating a Python object per DB.
+        db_x, db_y = self.sqconn.dbLocations()
+        self.dbs = np.column_stack((np.asarray(db_x, dtype=float),
+                np.asarray(db_y, dtype=float)))
+
+        # plugin parameters, validated against the definitions in the plugin 
+        # file before any work is done
+        self.sqconn.loadParameterSchema(os.path.join(
+            os.path.dirname(os.path.abspath(__file__)), 'dbp_recognition.sqplug'))
+        self.d_inner_max = self.sqconn.getDouble('max_dbp_inner_distance')
+        self.d_inner_min = self.sqconn.getDouble('min_dbp_inner_distance')
         print('inner_max={}, inner_min={}'.format(self.d_inner_max, self.d_inner_min))
 
     def perform_recognition(self):
@@ -94,7 +99,7 @@ class SiQADInterface:
         for i in range(len(self.dbp_aggs)):
             agg = []
             for db_ind in self.dbp_aggs[i]:
-                agg.append(self.dbs[db_ind])
+                agg.append(tuple(self.dbs[db_ind]))
             dbp_aggs_with_loc.append(agg)
         #print(dbp_aggs_with_loc)
 
@@ -0,0 +1,109 @@
+// @file:     bench_buffers.cc
+// @license:  Apache License 2.0
+//
+// @desc:     Compare the throughput of threads accumulating charge
+//            configurations through per-thread result buffers against a
+//            connector guarded by a mutex, at increasing thread counts.
+
+#include "siqadconn.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// configurations drawn by the threads
+struct StatePool
+{
+  StatePool(std::size_t n_states, std::size_t n_dbs)
+    : n_dbs(n_dbs), charges(n_states*n_dbs), energies(n_states)
+  {
+    uint32_t seed = 12345;
+    for (std::size_t i = 0; i < charges.size(); i++) {
+      seed = seed * 1664525u + 1013904223u;
+      charges[i] = static_cast<int8_t>((seed >> 16) % 3) - 1;
+    }
+    for (std::size_t i = 0; i < n_states; i++)
+      energies[i] = -1e-3 * static_cast<double>(i % 977);
+  }
+
+  std::size_t n_dbs;
+  std::vector<int8_t> charges;
+  std::vector<double> energies;
+};
+
+// accumulate n_configs configurations of pool on n_threads threads, through
+// per-thread buffers or a mutex-guarded connector, and return configs/s
+static double run(const std::string &problem_path, const StatePool &pool,
+    std::size_t n_configs, int n_threads, bool buffered)
+{
+  phys::SiQADConnector conn("bench_buffers", problem_path, "/dev/null");
+  conn.setLogLevel(phys::LogSilent);
+  std::mutex conn_mutex;
+  std::size_t n_states = pool.energies.size();
+
+  auto t_start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      std::shared_ptr<phys::ResultBuffer> buffer;
+      if (buffered)
+        buffer = conn.createResultBuffer();
+      uint32_t seed = 777u + t;
+      for (std::size_t i = t; i < n_configs; i += n_threads) {
+        seed = seed * 1664525u + 1013904223u;
+        std::size_t state = (seed >> 8) % n_states;
+        const int8_t *charges = pool.charges.data() + state*pool.n_dbs;
+        if (buffered) {
+          buffer->accumulateDBCharge(charges, pool.n_dbs, pool.energies[state]);
+        } else {
+          std::lock_guard<std::mutex> lock(conn_mutex);
+          conn.accumulateDBCharge(charges, pool.n_dbs, pool.energies[state]);
+        }
+      }
+    }));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  if (buffered)
+    conn.mergeResultBuffers();
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+  return n_configs / s;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <problem file> [n_configs] [n_states] "
+              << "[n_dbs] [threads ...]" << std::endl;
+    return 1;
+  }
+  std::string problem_path = argv[1];
+  std::size_t n_configs = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+  std::size_t n_states = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20000;
+  std::size_t n_dbs = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 100;
+  std::vector<int> thread_counts;
+  for (int i = 5; i < argc; i++)
+    thread_counts.push_back(std::atoi(argv[i]));
+  if (thread_counts.empty())
+    thread_counts = {1, 2, 4, 8, 16, 32};
+
+  StatePool pool(n_states, n_dbs);
+  std::cout << n_configs << " configs of " << n_dbs << " DBs from " << n_states
+            << " states, " << std::thread::hardware_concurrency()
+            << " hardware threads" << std::endl;
+  std::cout << "threads  mutex-guarded connector  per-thread buffers" << std::endl;
+  for (int n_threads : thread_counts) {
+    double mutex_rate = run(problem_path, pool, n_configs, n_threads, false);
+    double buffer_rate = run(problem_path, pool, n_configs, n_threads, true);
+    std::printf("%7d  %17.2f Mcfg/s  %12.2f Mcfg/s\n", n_threads,
+        mutex_rate * 1e-6, buffer_rate * 1e-6);
+  }
+  return 0;
+}
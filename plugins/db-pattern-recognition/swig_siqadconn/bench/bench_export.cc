@@ -0,0 +1,109 @@
+// @file:     bench_export.cc
+// @license:  Apache License 2.0
+//
+// @desc:     Time writing a side x side potential map through the string or
+//            the typed exports and report the peak RSS, which is the memory
+//            ceiling of the export as nothing else of size is allocated.
+//            Build with -DBENCH_STRING_ONLY against connectors that predate
+//            the typed exports (see run_export_bench).
+
+#include "siqadconn.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// peak resident set size of this process in MiB
+static double peakRssMiB()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.;   // ru_maxrss is in KiB on Linux
+}
+
+static double msSince(const std::chrono::steady_clock::time_point &t_start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_start).count();
+}
+
+// potential of the grid point (i, j), something cheap but not constant
+static double potentialAt(int i, int j)
+{
+  return 1e-3 * (i - j) + 1e-6 * i * j;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " <problem file> <result file> "
+              << "<string|double|float> [side]" << std::endl;
+    return 1;
+  }
+  std::string mode = argv[3];
+  int side = argc > 4 ? std::atoi(argv[4]) : 1000;
+  std::size_t rows = static_cast<std::size_t>(side) * side;
+
+  std::unique_ptr<phys::SiQADConnector> conn(
+      new phys::SiQADConnector("bench_export", argv[1], argv[2]));
+
+  auto t_start = std::chrono::steady_clock::now();
+  if (mode == "string") {
+    // the way plugins filled the potential map before the typed exports
+    std::vector<std::vector<std::string>> pot_data(rows);
+    char buf[32];
+    for (int i = 0; i < side; i++) {
+      for (int j = 0; j < side; j++) {
+        std::vector<std::string> &row = pot_data[static_cast<std::size_t>(i)*side + j];
+        std::snprintf(buf, sizeof(buf), "%.12g", i * 0.1);
+        row.push_back(buf);
+        std::snprintf(buf, sizeof(buf), "%.12g", j * 0.1);
+        row.push_back(buf);
+        std::snprintf(buf, sizeof(buf), "%.12g", potentialAt(i, j));
+        row.push_back(buf);
+      }
+    }
+    conn->setExport("potential", pot_data);
+#ifndef BENCH_STRING_ONLY
+  } else if (mode == "double" || mode == "float") {
+    std::vector<double> pot_d;
+    std::vector<float> pot_f;
+    if (mode == "double")
+      pot_d.reserve(3*rows);
+    else
+      pot_f.reserve(3*rows);
+    for (int i = 0; i < side; i++) {
+      for (int j = 0; j < side; j++) {
+        double row[3] = {i * 0.1, j * 0.1, potentialAt(i, j)};
+        if (mode == "double")
+          pot_d.insert(pot_d.end(), row, row + 3);
+        else
+          for (double v : row)
+            pot_f.push_back(static_cast<float>(v));
+      }
+    }
+    if (mode == "double")
+      conn->setExport("potential", pot_d.data(), rows, 3);
+    else
+      conn->setExport("potential", pot_f.data(), rows, 3);
+#endif
+  } else {
+    std::cerr << "Unknown mode " << mode << std::endl;
+    return 1;
+  }
+  double prepare_ms = msSince(t_start);
+
+  t_start = std::chrono::steady_clock::now();
+  conn.reset();   // results are written on destruction
+  double write_ms = msSince(t_start);
+
+  std::cerr << mode << ": " << rows << " potential values, prepare " << prepare_ms
+            << " ms, write " << write_ms << " ms, peak RSS " << peakRssMiB()
+            << " MiB" << std::endl;
+  return 0;
+}
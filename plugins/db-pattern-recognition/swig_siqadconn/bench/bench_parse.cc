@@ -0,0 +1,60 @@
+// @file:     bench_parse.cc
+// @license:  Apache License 2.0
+//
+// @desc:     Time SiQADConnector problem parsing. Only the public constructor
+//            is used so that the same source builds against older revisions
+//            of the connector for comparison (see run_parse_bench). Results
+//            go to stderr so that the connector's own stdout logging can be
+//            redirected independently.
+
+#include "siqadconn.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// peak resident set size of this process in MiB
+static double peakRssMiB()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.;   // ru_maxrss is in KiB on Linux
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <problem file> [repeats]" << std::endl;
+    return 1;
+  }
+  std::string problem_path = argv[1];
+  int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+  double best_ms = -1;
+  std::size_t n_dbs = 0;
+  for (int i = 0; i < repeats; i++) {
+    auto t_start = std::chrono::steady_clock::now();
+    std::unique_ptr<phys::SiQADConnector> conn(
+        new phys::SiQADConnector("bench_parse", problem_path, "/dev/null"));
+    auto t_end = std::chrono::steady_clock::now();
+
+    n_dbs = 0;
+    phys::DBCollection *db_col = conn->dbCollection();
+    for (phys::DBIterator it = db_col->begin(); it != db_col->end(); ++it)
+      n_dbs++;
+
+    double ms = std::chrono::duration<double, std::milli>(t_end - t_start).count();
+    if (best_ms < 0 || ms < best_ms)
+      best_ms = ms;
+  }
+
+  std::cerr << problem_path << ": " << n_dbs << " DBs, best of " << repeats
+            << " parses " << best_ms << " ms, peak RSS " << peakRssMiB()
+            << " MiB" << std::endl;
+  return 0;
+}
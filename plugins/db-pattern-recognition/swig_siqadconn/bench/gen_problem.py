@@ -0,0 +1,70 @@
+#!/usr/bin/env python
+# encoding: utf-8
+
+'''
+Generate a SiQAD problem file with a given number of DBs for benchmarking the
+connector's problem parsing. DBs are laid out on the H-Si(100)-2x1 lattice in
+a square patch, with a row of electrodes alongside.
+'''
+
+__copyright__   = 'Apache License 2.0'
+
+from argparse import ArgumentParser
+import math
+
+LAT_A = 3.84    # lattice constants in angstrom
+LAT_B = 7.68
+LAT_C = 2.25
+
+def write_problem(f, n_dbs, n_elecs):
+    '''Write a problem file with n_dbs DBs and n_elecs electrodes to f.'''
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n<siqad>\n')
+    f.write('  <program>\n    <file_purpose>simulation</file_purpose>\n'
+            '    <version>bench</version>\n  </program>\n')
+    f.write('  <sim_params>\n    <num_threads>1</num_threads>\n  </sim_params>\n')
+
+    f.write('  <layers>\n')
+    for name, ltype, zoffset, zheight in [('Lattice', 'Lattice', 0, 0),
+                                          ('Surface', 'DB', 0, 0),
+                                          ('Metal', 'Electrode', -100, 10)]:
+        f.write('    <layer_prop>\n      <name>%s</name>\n      <type>%s</type>\n'
+                '      <zoffset>%g</zoffset>\n      <zheight>%g</zheight>\n'
+                '    </layer_prop>\n' % (name, ltype, zoffset, zheight))
+    f.write('  </layers>\n')
+
+    f.write('  <design>\n    <layer type="Lattice"/>\n    <layer type="Misc"/>\n')
+    f.write('    <layer type="DB">\n')
+    side = max(1, int(math.ceil(math.sqrt(n_dbs / 2.))))
+    for i in range(n_dbs):
+        n, m, l = (i // 2) % side, (i // 2) // side, i % 2
+        f.write('      <dbdot>\n        <layer_id>2</layer_id>\n'
+                '        <latcoord n="%d" m="%d" l="%d"/>\n'
+                '        <physloc x="%g" y="%g"/>\n      </dbdot>\n'
+                % (n, m, l, n*LAT_A, m*LAT_B + l*LAT_C))
+    f.write('    </layer>\n')
+
+    f.write('    <layer type="Electrode">\n')
+    for i in range(n_elecs):
+        x1 = -100. - 60.*i
+        f.write('      <electrode>\n        <layer_id>3</layer_id>\n'
+                '        <angle>0</angle>\n'
+                '        <dim x1="%g" y1="0" x2="%g" y2="%g"/>\n'
+                '        <pixel_per_angstrom>10</pixel_per_angstrom>\n'
+                '        <property_map>\n'
+                '          <potential><val>%g</val></potential>\n'
+                '          <phase><val>0</val></phase>\n'
+                '          <type><val>fixed</val></type>\n'
+                '          <net><val>%d</val></net>\n'
+                '        </property_map>\n      </electrode>\n'
+                % (x1, x1 + 50., side*LAT_B, 0.1*(i+1), i))
+    f.write('    </layer>\n  </design>\n</siqad>\n')
+
+if __name__ == '__main__':
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('n_dbs', type=int, help='Number of DBs.')
+    parser.add_argument('out_file', help='Path of the problem file to write.')
+    parser.add_argument('--electrodes', type=int, default=10,
+            help='Number of electrodes (default 10).')
+    args = parser.parse_args()
+    with open(args.out_file, 'w') as f:
+        write_problem(f, args.n_dbs, args.electrodes)
@@ -10,6 +10,7 @@ os.environ["CC"] = "g++"
 os.environ["CXX"] = "g++"
 siqadconn_module = Extension('_siqadconn',
                                 sources=['siqadconn_wrap.cxx', 'siqadconn.cc'],
+                                extra_compile_args=['-std=c++11', '-O3', '-fno-math-errno'],
                                 )
 
 setup (
@@ -8,10 +8,23 @@
 
 #include "siqadconn.h"
 #include <iostream>
+#include <fstream>
+#include <cctype>
 #include <stdexcept>
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <type_traits>
 #include <boost/algorithm/string/join.hpp>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 
 using namespace phys;
@@ -24,22 +37,60 @@ SiQADConnector::SiQADConnector(const std::string &eng_name,
   const std::string &input_path, const std::string &output_path)
   : eng_name(eng_name), input_path(input_path), output_path(output_path)
 {
+  // the environment overrides the log level of the problem file
+  const char *env_log_level = std::getenv("SIQADCONN_LOG_LEVEL");
+  if (env_log_level) {
+    log_level_from_env = setLogLevel(env_log_level);
+    if (!log_level_from_env)
+      std::cerr << "Unknown SIQADCONN_LOG_LEVEL " << env_log_level << std::endl;
+  }
+
   // initialize variables
   item_tree = std::make_shared<Aggregate>();
   start_time = std::chrono::system_clock::now();
   elec_col = new ElectrodeCollection(item_tree);
   elec_poly_col = new ElectrodePolyCollection(item_tree);
-  db_col = new DBCollection(item_tree);
+  db_col = new DBCollection(item_tree, &db_store);
 
   // read problem from input_path
-  readProblem(input_path);
+  {
+    ScopedPhase phase(*this, "parse");
+    readProblem(input_path);
+  }
+
+  // flatten the DBs into the contiguous store
+  {
+    ScopedPhase phase(*this, "setup");
+    db_store.build(item_tree);
+    for (ElecIterator it = elec_col->begin(); it != elec_col->end(); ++it) {
+      const Electrode &elec = **it;
+      const double row[electrode_table_cols] = {
+        static_cast<double>(elec.layer_id), elec.x1, elec.y1, elec.x2, elec.y2,
+        elec.potential, elec.phase, static_cast<double>(elec.electrode_type),
+        static_cast<double>(elec.net), elec.angle, elec.pixel_per_angstrom,
+        elec.pot_offset};
+      elec_table.insert(elec_table.end(), row, row + electrode_table_cols);
+    }
+  }
+  log(LogInfo) << "Read " << db_store.size() << " DBs" << std::endl;
+
+  // keep the problem as given for batch mode variants
+  base_sim_params = sim_params;
+  base_output_path = output_path;
+}
+
+//DESTRUCTOR
+SiQADConnector::~SiQADConnector()
+{
+  writeResultsXml();
 }
 
 void SiQADConnector::setExport(std::string type, std::vector< std::pair< std::string, std::string > > &data_in)
 {
-  if (type == "db_loc")
+  if (type == "db_loc") {
     dbl_data = data_in;
-  else
+    typed_exports.erase(type);
+  } else
     throw std::invalid_argument(std::string("No candidate for export type '") +
         type + std::string("' with class std::vector<std::pair<std::string, std::string>>"));
 }
@@ -57,421 +108,2627 @@ void SiQADConnector::setExport(std::string type, std::vector< std::vector< std::
   else
     throw std::invalid_argument(std::string("No candidate for export type '") +
         type + std::string("' with class std::vector<std::vector<std::string>>"));
+
+  // string data replaces previously set typed data of the same type
+  typed_exports.erase(type);
+  if (type == "db_charge")
+    charge_export = ChargeExport();
 }
 
-void SiQADConnector::addSQCommand(SQCommand *command)
+void SiQADConnector::setExport(std::string type, const double *data_in, std::size_t rows, std::size_t cols)
 {
-  export_commands.push_back(command->finalCommand());
-  std::cout << "Command added to SiQADConnector: " << std::endl;
-  std::cout << export_commands.back() << std::endl;
+  setTypedExport(type, data_in, rows, cols);
 }
 
+void SiQADConnector::setExport(std::string type, const float *data_in, std::size_t rows, std::size_t cols)
+{
+  setTypedExport(type, data_in, rows, cols);
+}
 
-
-// FILE HANDLING
-// parse problem XML, return true if successful
-void SiQADConnector::readProblem(const std::string &path)
+template <typename T>
+void SiQADConnector::setTypedExport(const std::string &type, const T *data_in,
+    std::size_t rows, std::size_t cols)
 {
-  std::cout << "Reading problem file: " << input_path << std::endl;
+  std::size_t expected_cols;
+  if (type == "db_loc")
+    expected_cols = 2;
+  else if (type == "potential")
+    expected_cols = 3;
+  else if (type == "db_pot")
+    expected_cols = 4;
+  else if (type == "electrodes")
+    expected_cols = 5;
+  else
+    throw std::invalid_argument(std::string("No candidate for export type '") +
+        type + std::string("' with a numeric table"));
+  if (cols != expected_cols)
+    throw std::invalid_argument(std::string("Export type '") + type + "' expects "
+        + std::to_string(expected_cols) + " columns, got " + std::to_string(cols));
 
-  bpt::ptree tree; // create empty property tree object
-  bpt::read_xml(path, tree, bpt::xml_parser::no_comments); // parse the input file into property tree
+  ExportTable &table = typed_exports[type];
+  table.cols = cols;
+  table.values.assign(data_in, data_in + rows*cols);
+  table.single_precision = std::is_same<T, float>::value;
 
-  // parse XML
+  // typed data replaces previously set string data of the same type
+  if (type == "db_loc")
+    dbl_data.clear();
+  else if (type == "potential")
+    pot_data.clear();
+  else if (type == "db_pot")
+    db_pot_data.clear();
+  else if (type == "electrodes")
+    elec_data.clear();
+}
 
-  // read program properties
-  // TODO read program node
+void SiQADConnector::setDBChargeExport(const int8_t *charges, std::size_t n_dbs,
+    std::size_t n_configs, const double *energies, const int *counts,
+    const int8_t *physically_valid)
+{
+  charge_export.n_dbs = n_dbs;
+  charge_export.charges.assign(charges, charges + n_dbs*n_configs);
+  charge_export.energies.assign(energies, energies + n_configs);
+  if (counts)
+    charge_export.counts.assign(counts, counts + n_configs);
+  else
+    charge_export.counts.clear();
+  if (physically_valid)
+    charge_export.physically_valid.assign(physically_valid, physically_valid + n_configs);
+  else
+    charge_export.physically_valid.clear();
+  db_charge_data.clear();
+}
 
-  // read simulation parameters
-  std::cout << "Read simulation parameters" << std::endl;
-  readSimulationParam(tree.get_child("siqad.sim_params"));
+int SiQADConnector::threadCount() const
+{
+  if (num_threads > 0)
+    return num_threads;
+  unsigned int hw_threads = std::thread::hardware_concurrency();
+  return hw_threads > 0 ? static_cast<int>(hw_threads) : 1;
+}
 
-  // read layer properties
-  std::cout << "Read layer properties" << std::endl;
-  readLayers(tree.get_child("siqad.layers"));
+// Split the rows of a packed upper triangle of dimension dim into contiguous
+// blocks holding roughly the same number of elements and call fn(row_begin,
+// row_end) for each block on its own thread.
+static void parallelTriangleRows(std::size_t dim, int n_threads,
+    const std::function<void(std::size_t, std::size_t)> &fn)
+{
+  std::size_t n_elems = dim > 1 ? dim*(dim-1)/2 : 0;
+  std::size_t n_blocks = std::max<std::size_t>(1, std::min<std::size_t>(n_threads, dim));
+  if (n_blocks == 1 || n_elems < 4096) {
+    fn(0, dim);
+    return;
+  }
 
-  // read items
-  std::cout << "Read items tree" << std::endl;
-  readDesign(tree.get_child("siqad.design"), item_tree);
+  std::vector<std::thread> threads;
+  std::size_t row_begin=0, elems_done=0;
+  for (std::size_t b=0; b<n_blocks && row_begin<dim; b++) {
+    std::size_t target = n_elems * (b+1) / n_blocks;
+    std::size_t row_end = row_begin;
+    while (row_end < dim && (elems_done < target || row_end == row_begin)) {
+      elems_done += dim - row_end - 1;
+      row_end++;
+    }
+    if (b == n_blocks-1)
+      row_end = dim;
+    threads.push_back(std::thread(fn, row_begin, row_end));
+    row_begin = row_end;
+  }
+  for (std::thread &th : threads)
+    th.join();
 }
 
-void SiQADConnector::readProgramProp(const bpt::ptree &program_prop_tree)
+// Write the distances between DB i and DBs i+1 ... N-1 to out. Kept free of
+// branches and function calls other than sqrt so that it auto-vectorizes.
+template <typename T>
+static void dbDistanceRow(const DBStore &store, std::size_t i, T *__restrict out)
 {
-  for (bpt::ptree::value_type const &v : program_prop_tree) {
-    program_props.insert(std::map<std::string, std::string>::value_type(v.first, v.second.data()));
-    std::cout << "ProgramProp: Key=" << v.first << ", Value=" << program_props[v.first] << std::endl;
+  const std::size_t len = store.size() - i - 1;
+  const float *__restrict xj = store.x.data() + i + 1;
+  const float *__restrict yj = store.y.data() + i + 1;
+  const double xi = store.x[i];
+  const double yi = store.y[i];
+  for (std::size_t k=0; k<len; k++) {
+    double dx = xj[k] - xi;
+    double dy = yj[k] - yi;
+    out[k] = static_cast<T>(std::sqrt(dx*dx + dy*dy));
   }
 }
 
-void SiQADConnector::readLayers(const bpt::ptree &layer_prop_tree)
+const PackedSymmetricMatrix<float> &SiQADConnector::dbDistanceMatrix()
 {
-  // if this were structured the same way as readDesign, then only the first layer_prop subtree would be read.
-  // TODO: make this more general.
-  for (bpt::ptree::value_type const &v : layer_prop_tree)
-    readLayerProp(v.second);
+  std::lock_guard<std::mutex> lock(pairwise_mutex);
+  if (!db_dist_mat) {
+    ScopedPhase phase(*this, "setup");
+    std::shared_ptr<PackedSymmetricMatrix<float>> mat =
+        std::make_shared<PackedSymmetricMatrix<float>>(db_store.size());
+    parallelTriangleRows(db_store.size(), threadCount(),
+        [this, &mat](std::size_t row_begin, std::size_t row_end)
+        {
+          for (std::size_t i=row_begin; i<row_end; i++)
+            dbDistanceRow(db_store, i, mat->row(i));
+        });
+    db_dist_mat = mat;
+  }
+  return *db_dist_mat;
 }
 
-void SiQADConnector::readLayerProp(const bpt::ptree &layer_node)
+const PackedSymmetricMatrix<double> &SiQADConnector::dbInteractionMatrix()
 {
-  Layer lay;
-  lay.name = layer_node.get<std::string>("name");
-  lay.type = layer_node.get<std::string>("type");
-  lay.zoffset = layer_node.get<float>("zoffset");
-  lay.zheight = layer_node.get<float>("zheight");
+  std::lock_guard<std::mutex> lock(pairwise_mutex);
+  if (!db_interaction_mat) {
+    ScopedPhase phase(*this, "setup");
+    std::shared_ptr<PackedSymmetricMatrix<double>> mat =
+        std::make_shared<PackedSymmetricMatrix<double>>(db_store.size());
+    computeDBInteractions(*mat);
+    db_interaction_mat = mat;
+  }
+  return *db_interaction_mat;
+}
 
-  layers.push_back(lay);
-  std::cout << "Retrieved layer " << lay.name << " of type " << lay.type << std::endl;
+const PackedSymmetricMatrix<float> &SiQADConnector::dbInteractionMatrixFloat()
+{
+  std::lock_guard<std::mutex> lock(pairwise_mutex);
+  if (!db_interaction_mat_f) {
+    ScopedPhase phase(*this, "setup");
+    std::shared_ptr<PackedSymmetricMatrix<float>> mat =
+        std::make_shared<PackedSymmetricMatrix<float>>(db_store.size());
+    computeDBInteractions(*mat);
+    db_interaction_mat_f = mat;
+  }
+  return *db_interaction_mat_f;
 }
 
+std::shared_ptr<const LatticeInteractionKernel> SiQADConnector::latticeInteractionKernel(double cutoff)
+{
+  std::lock_guard<std::mutex> lock(pairwise_mutex);
+  if (!lattice_kernel || lattice_kernel->cutoff() != cutoff) {
+    ScopedPhase phase(*this, "setup");
+    lattice_kernel = std::make_shared<LatticeInteractionKernel>(lattice, screenedCoulomb(), cutoff);
+  }
+  return lattice_kernel;
+}
 
-void SiQADConnector::readSimulationParam(const bpt::ptree &sim_params_tree)
+std::shared_ptr<const DBSpatialIndex> SiQADConnector::spatialIndex(double r)
 {
-  for (bpt::ptree::value_type const &v : sim_params_tree) {
-    sim_params.insert(std::map<std::string, std::string>::value_type(v.first, v.second.data()));
-    std::cout << "SimParam: Key=" << v.first << ", Value=" << sim_params[v.first] << std::endl;
+  if (!(r > 0))
+    throw std::invalid_argument("Spatial queries require a positive radius");
+  std::lock_guard<std::mutex> lock(pairwise_mutex);
+  if (!spatial_index || r > 2*spatial_index->cellSize() || r < 0.5*spatial_index->cellSize()) {
+    ScopedPhase phase(*this, "setup");
+    spatial_index = std::make_shared<DBSpatialIndex>(db_store, r);
   }
+  return spatial_index;
 }
 
-void SiQADConnector::readDesign(const bpt::ptree &subtree, const std::shared_ptr<Aggregate> &agg_parent)
+std::vector<int> SiQADConnector::neighborsWithin(std::size_t i, double r)
 {
-  std::cout << "Beginning to read design" << std::endl;
-  for (bpt::ptree::value_type const &layer_tree : subtree) {
-    std::string layer_type = layer_tree.second.get<std::string>("<xmlattr>.type");
-    if ((!layer_type.compare("DB"))) {
-      std::cout << "Encountered node " << layer_tree.first << " with type " << layer_type << ", entering" << std::endl;
-      readItemTree(layer_tree.second, agg_parent);
-    } else if ( (!layer_type.compare("Electrode"))) {
-      std::cout << "Encountered node " << layer_tree.first << " with type " << layer_type << ", entering" << std::endl;
-      readItemTree(layer_tree.second, agg_parent);
-    } else {
-      std::cout << "Encountered node " << layer_tree.first << " with type " << layer_type << ", no defined action for this layer. Skipping." << std::endl;
+  if (i >= db_store.size())
+    throw std::out_of_range("DB index " + std::to_string(i) + " out of range");
+  std::vector<int> neighbors;
+  spatialIndex(r)->neighborsWithin(i, r, neighbors);
+  return neighbors;
+}
+
+std::vector<int> SiQADConnector::dbClusters(double cutoff)
+{
+  const std::size_t n_dbs = db_store.size();
+  std::vector<int> parent(n_dbs), rank(n_dbs, 0);
+  for (std::size_t i=0; i<n_dbs; i++)
+    parent[i] = static_cast<int>(i);
+
+  // union-find with path halving and union by rank
+  auto find = [&parent](int i)
+  {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+
+  if (n_dbs > 0) {
+    std::shared_ptr<const DBSpatialIndex> index = spatialIndex(cutoff);
+    std::vector<int> neighbors;
+    for (std::size_t i=0; i<n_dbs; i++) {
+      neighbors.clear();
+      index->neighborsWithin(i, cutoff, neighbors);
+      for (int j : neighbors) {
+        int root_i = find(static_cast<int>(i)), root_j = find(j);
+        if (root_i == root_j)
+          continue;
+        if (rank[root_i] < rank[root_j])
+          std::swap(root_i, root_j);
+        parent[root_j] = root_i;
+        if (rank[root_i] == rank[root_j])
+          rank[root_i]++;
+      }
     }
   }
+
+  // number the clusters in order of their first DB
+  std::vector<int> cluster_id(n_dbs, -1), clusters(n_dbs);
+  int n_clusters = 0;
+  for (std::size_t i=0; i<n_dbs; i++) {
+    int root = find(static_cast<int>(i));
+    if (cluster_id[root] == -1)
+      cluster_id[root] = n_clusters++;
+    clusters[i] = cluster_id[root];
+  }
+  return clusters;
 }
 
-void SiQADConnector::readItemTree(const bpt::ptree &subtree, const std::shared_ptr<Aggregate> &agg_parent)
+// ELECTRODE POTENTIALS
+
+static const double elec_pi = 3.14159265358979323846;
+static const double deg_to_rad = elec_pi / 180.;
+
+// Electrode converted to angstroms in the frame of the DBs, either a
+// rectangle spanning [-half_w, half_w] x [-half_h, half_h] about (cx, cy)
+// in its own frame rotated by angle, or a polygon.
+struct ElectrodePatch
 {
-  for (bpt::ptree::value_type const &item_tree : subtree) {
-    std::string item_name = item_tree.first;
-    std::cout << "item_name: " << item_name << std::endl;
-    if (!item_name.compare("aggregate")) {
-      // add aggregate child to tree
-      agg_parent->aggs.push_back(std::make_shared<Aggregate>());
-      readItemTree(item_tree.second, agg_parent->aggs.back());
-    } else if (!item_name.compare("dbdot")) {
-      // add DBDot to tree
-      readDBDot(item_tree.second, agg_parent);
-    } else if (!item_name.compare("electrode")) {
-      // add Electrode to tree
-      readElectrode(item_tree.second, agg_parent);
-    } else if (!item_name.compare("electrode_poly")) {
-      // add Electrode to tree
-      readElectrodePoly(item_tree.second, agg_parent);
-    } else {
-      std::cout << "Encountered unknown item node: " << item_tree.first << std::endl;
-    }
+  bool is_rect;
+  double cx, cy, half_w, half_h, cos_a, sin_a;
+  std::vector<std::pair<double, double>> vertices;
+  double z;                       // height above the DBs
+  double v_fixed, v_cos, v_sin;   // potential components, see ElectrodeCoupling
+};
+
+// Set the potential components of a patch from electrode properties.
+static void setPatchPotential(ElectrodePatch &patch, int electrode_type,
+    double potential, double pot_offset, double phase)
+{
+  if (electrode_type == 1) {
+    // pot_offset + potential*sin(phase + p) expanded in cos(p) and sin(p)
+    const double phase_rad = phase * deg_to_rad;
+    patch.v_fixed = pot_offset;
+    patch.v_cos = potential * std::sin(phase_rad);
+    patch.v_sin = potential * std::cos(phase_rad);
+  } else {
+    patch.v_fixed = potential;
+    patch.v_cos = 0;
+    patch.v_sin = 0;
   }
 }
 
-void SiQADConnector::readElectrode(const bpt::ptree &subtree, const std::shared_ptr<Aggregate> &agg_parent)
+// Return the solid angle subtended by the rectangle [x1, x2] x [y1, y2] in
+// the plane at height z above the origin.
+static double rectSolidAngle(double x1, double x2, double y1, double y2, double z)
 {
-  double x1, x2, y1, y2, pixel_per_angstrom, potential, phase, angle;
-  int layer_id, electrode_type=0, net;
-  // read values from XML stream
-  layer_id = subtree.get<int>("layer_id");
-  angle = subtree.get<double>("angle");
-  potential = subtree.get<double>("property_map.potential.val");
-  phase = subtree.get<double>("property_map.phase.val");
-  std::string electrode_type_s = subtree.get<std::string>("property_map.type.val");
-  if (!electrode_type_s.compare("fixed")){
-    electrode_type = 0;
-  } else if (!electrode_type_s.compare("clocked")) {
-    electrode_type = 1;
+  auto corner = [z](double x, double y)
+  {
+    return std::atan(x*y / (z*std::sqrt(x*x + y*y + z*z)));
+  };
+  return corner(x2, y2) - corner(x1, y2) - corner(x2, y1) + corner(x1, y1);
+}
+
+// Return the solid angle subtended by a simple polygon in the plane at height
+// z above (px, py), summed over the triangles formed by the point straight
+// above (px, py) and each edge (Van Oosterom and Strackee).
+static double polygonSolidAngle(const std::vector<std::pair<double, double>> &vertices,
+    double px, double py, double z)
+{
+  double omega = 0;
+  const double z2 = z*z;
+  for (std::size_t i=0; i<vertices.size(); i++) {
+    const std::pair<double, double> &vb = vertices[i];
+    const std::pair<double, double> &vc = vertices[(i+1) % vertices.size()];
+    const double bx = vb.first - px, by = vb.second - py;
+    const double cx = vc.first - px, cy = vc.second - py;
+    const double lb = std::sqrt(bx*bx + by*by + z2);
+    const double lc = std::sqrt(cx*cx + cy*cy + z2);
+    // triple product and denominator of tan(omega/2), divided through by z
+    const double num = bx*cy - by*cx;
+    const double den = lb*lc + z*(lb + lc) + bx*cx + by*cy + z2;
+    omega += 2 * std::atan2(num, den);
   }
-  net = subtree.get<int>("property_map.net.val");
-  pixel_per_angstrom = subtree.get<double>("pixel_per_angstrom");
-  x1 = subtree.get<double>("dim.<xmlattr>.x1");
-  x2 = subtree.get<double>("dim.<xmlattr>.x2");
-  y1 = subtree.get<double>("dim.<xmlattr>.y1");
-  y2 = subtree.get<double>("dim.<xmlattr>.y2");
-  agg_parent->elecs.push_back(std::make_shared<Electrode>(layer_id,x1,x2,y1,y2,potential,phase,electrode_type,pixel_per_angstrom,net,angle));
+  return std::abs(omega);
+}
 
-  std::cout << "Electrode created with x1=" << agg_parent->elecs.back()->x1 << ", y1=" << agg_parent->elecs.back()->y1 <<
-    ", x2=" << agg_parent->elecs.back()->x2 << ", y2=" << agg_parent->elecs.back()->y2 <<
-    ", potential=" << agg_parent->elecs.back()->potential << std::endl;
+// Split [0, n) into contiguous blocks and call fn(begin, end) for each block
+// on its own thread.
+static void parallelRanges(std::size_t n, int n_threads,
+    const std::function<void(std::size_t, std::size_t)> &fn)
+{
+  std::size_t n_blocks = std::max<std::size_t>(1, std::min<std::size_t>(n_threads, n / 1024));
+  if (n_blocks == 1) {
+    fn(0, n);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (std::size_t b=0; b<n_blocks; b++)
+    threads.push_back(std::thread(fn, n*b/n_blocks, n*(b+1)/n_blocks));
+  for (std::thread &th : threads)
+    th.join();
 }
 
-void SiQADConnector::readElectrodePoly(const bpt::ptree &subtree, const std::shared_ptr<Aggregate> &agg_parent)
+std::shared_ptr<const SiQADConnector::ElectrodeCoupling> SiQADConnector::electrodeCoupling()
 {
-  double pixel_per_angstrom, potential, phase;
-  std::vector<std::pair<double, double>> vertices;
-  int layer_id, electrode_type=0, net;
-  // read values from XML stream
-  layer_id = subtree.get<int>("layer_id");
-  potential = subtree.get<double>("property_map.potential.val");
-  phase = subtree.get<double>("property_map.phase.val");
-  std::string electrode_type_s = subtree.get<std::string>("property_map.type.val");
-  if (!electrode_type_s.compare("fixed")){
-    electrode_type = 0;
-  } else if (!electrode_type_s.compare("clocked")) {
-    electrode_type = 1;
+  std::lock_guard<std::mutex> lock(pairwise_mutex);
+  if (electrode_coupling)
+    return electrode_coupling;
+  ScopedPhase phase(*this, "setup");
+
+  // convert the electrodes once
+  auto layerHeight = [this](int layer_id)
+  {
+    if (layer_id < 0 || layer_id >= static_cast<int>(layers.size()))
+      throw std::invalid_argument("Electrode refers to unknown layer "
+          + std::to_string(layer_id));
+    // keep DBs on the plane of an electrode off its edges
+    return std::max<double>(std::abs(layers[layer_id].zoffset), 1e-6);
+  };
+  std::vector<ElectrodePatch> patches;
+  for (ElecIterator it = elec_col->begin(); it != elec_col->end(); ++it) {
+    const Electrode &elec = **it;
+    ElectrodePatch patch;
+    patch.is_rect = true;
+    patch.cx = 0.5 * (elec.x1 + elec.x2);
+    patch.cy = 0.5 * (elec.y1 + elec.y2);
+    patch.half_w = 0.5 * std::abs(elec.x2 - elec.x1);
+    patch.half_h = 0.5 * std::abs(elec.y2 - elec.y1);
+    patch.cos_a = std::cos(elec.angle * deg_to_rad);
+    patch.sin_a = std::sin(elec.angle * deg_to_rad);
+    patch.z = layerHeight(elec.layer_id);
+    setPatchPotential(patch, elec.electrode_type, elec.potential, elec.pot_offset, elec.phase);
+    patches.push_back(patch);
   }
-  pixel_per_angstrom = subtree.get<double>("pixel_per_angstrom");
-  net = subtree.get<int>("property_map.net.val");
-  //cycle through the vertices
-  std::pair<double, double> point;
-  for (auto val: subtree) {
-    if(val.first == "vertex") {
-      double x = std::stod(val.second.get_child("<xmlattr>.x").data());
-      double y = std::stod(val.second.get_child("<xmlattr>.y").data());
-      point = std::make_pair(x, y);
-      vertices.push_back(point);
-    }
+  for (ElecPolyIterator it = elec_poly_col->begin(); it != elec_poly_col->end(); ++it) {
+    const ElectrodePoly &elec = **it;
+    ElectrodePatch patch;
+    patch.is_rect = false;
+    patch.vertices = elec.vertices;
+    patch.z = layerHeight(elec.layer_id);
+    setPatchPotential(patch, elec.electrode_type, elec.potential, elec.pot_offset, elec.phase);
+    patches.push_back(patch);
   }
-  agg_parent->elec_polys.push_back(std::make_shared<ElectrodePoly>(layer_id,vertices,potential,phase,electrode_type,pixel_per_angstrom,net));
 
-  std::cout << "ElectrodePoly created with " << agg_parent->elec_polys.back()->vertices.size() <<
-    " vertices, potential=" << agg_parent->elec_polys.back()->potential << std::endl;
+  // DB blocks are independent, so each thread handles all electrodes over
+  // its own block without any reduction
+  std::shared_ptr<ElectrodeCoupling> coupling = std::make_shared<ElectrodeCoupling>();
+  const std::size_t n_dbs = db_store.size();
+  coupling->fixed.assign(n_dbs, 0.);
+  coupling->cos_coef.assign(n_dbs, 0.);
+  coupling->sin_coef.assign(n_dbs, 0.);
+  parallelRanges(n_dbs, patches.empty() ? 1 : threadCount(),
+      [&](std::size_t begin, std::size_t end)
+      {
+        for (const ElectrodePatch &patch : patches) {
+          for (std::size_t i=begin; i<end; i++) {
+            double omega;
+            if (patch.is_rect) {
+              // DB location in the frame of the rectangle
+              const double dx = db_store.x[i] - patch.cx;
+              const double dy = db_store.y[i] - patch.cy;
+              const double u = dx*patch.cos_a + dy*patch.sin_a;
+              const double v = -dx*patch.sin_a + dy*patch.cos_a;
+              omega = rectSolidAngle(-patch.half_w - u, patch.half_w - u,
+                  -patch.half_h - v, patch.half_h - v, patch.z);
+            } else {
+              omega = polygonSolidAngle(patch.vertices, db_store.x[i],
+                  db_store.y[i], patch.z);
+            }
+            const double weight = omega / (2*elec_pi);
+            coupling->fixed[i] += weight * patch.v_fixed;
+            coupling->cos_coef[i] += weight * patch.v_cos;
+            coupling->sin_coef[i] += weight * patch.v_sin;
+          }
+        }
+      });
+  log(LogInfo) << "Computed coupling of " << patches.size() << " electrodes to "
+    << n_dbs << " DBs" << '\n';
+  electrode_coupling = coupling;
+  return electrode_coupling;
+}
+
+std::vector<double> SiQADConnector::dbElectrodePotentials(double clock_phase)
+{
+  std::vector<double> potentials(db_store.size());
+  dbElectrodePotentials(clock_phase, potentials.data());
+  return potentials;
 }
 
-void SiQADConnector::readDBDot(const bpt::ptree &subtree, const std::shared_ptr<Aggregate> &agg_parent)
+void SiQADConnector::dbElectrodePotentials(double clock_phase, double *out)
 {
-  float x, y;
-  int n, m, l;
+  std::shared_ptr<const ElectrodeCoupling> coupling = electrodeCoupling();
+  const double c = std::cos(clock_phase * deg_to_rad);
+  const double s = std::sin(clock_phase * deg_to_rad);
+  const double *__restrict fixed = coupling->fixed.data();
+  const double *__restrict cos_coef = coupling->cos_coef.data();
+  const double *__restrict sin_coef = coupling->sin_coef.data();
+  for (std::size_t i=0; i<coupling->fixed.size(); i++)
+    out[i] = fixed[i] + c*cos_coef[i] + s*sin_coef[i];
+}
 
-  // read x and y physical locations
-  x = subtree.get<float>("physloc.<xmlattr>.x");
-  y = subtree.get<float>("physloc.<xmlattr>.y");
+ScreenedCoulomb SiQADConnector::screenedCoulomb()
+{
+  if (!findParameter("eps_r") || !findParameter("debye_length"))
+    throw std::invalid_argument("eps_r and debye_length simulation parameters "
+        "are required to compute DB interactions");
+  return ScreenedCoulomb(getDouble("eps_r"), getDouble("debye_length"));
+}
 
-  // read n, m and l lattice coordinates
-  n = subtree.get<int>("latcoord.<xmlattr>.n");
-  m = subtree.get<int>("latcoord.<xmlattr>.m");
-  l = subtree.get<int>("latcoord.<xmlattr>.l");
+template <typename T>
+void SiQADConnector::computeDBInteractions(PackedSymmetricMatrix<T> &mat)
+{
+  const ScreenedCoulomb v = screenedCoulomb();
+
+  parallelTriangleRows(db_store.size(), threadCount(),
+      [&](std::size_t row_begin, std::size_t row_end)
+      {
+        std::vector<double> r(db_store.size());
+        for (std::size_t i=row_begin; i<row_end; i++) {
+          const std::size_t len = db_store.size() - i - 1;
+          dbDistanceRow(db_store, i, r.data());
+          T *__restrict out = mat.row(i);
+          for (std::size_t k=0; k<len; k++)
+            out[k] = static_cast<T>(v(r[k]));
+        }
+      });
+}
+
+void SiQADConnector::addSQCommand(SQCommand *command)
+{
+  export_commands.push_back(command->finalCommand());
+  if (logEnabled(LogDebug))
+    log(LogDebug) << "Command added to SiQADConnector: " << export_commands.back() << '\n';
+}
 
-  agg_parent->dbs.push_back(std::make_shared<DBDot>(x, y, n, m, l));
 
-  std::cout << "DBDot created with x=" << agg_parent->dbs.back()->x
-            << ", y=" << agg_parent->dbs.back()->y
-            << ", n=" << agg_parent->dbs.back()->n
-            << ", m=" << agg_parent->dbs.back()->m
-            << ", l=" << agg_parent->dbs.back()->l
-            << std::endl;
+// LOGGING
+
+// stream without buffer, all output to it is discarded
+static std::ostream null_log(nullptr);
+
+std::ostream &SiQADConnector::log(LogLevel level)
+{
+  return logEnabled(level) ? std::cout : null_log;
 }
 
-void SiQADConnector::writeResultsXml()
+bool SiQADConnector::setLogLevel(const std::string &name)
 {
-  std::cout << "SiQADConnector::writeResultsXml()" << std::endl;
+  if (name == "silent")
+    log_level = LogSilent;
+  else if (name == "info")
+    log_level = LogInfo;
+  else if (name == "debug")
+    log_level = LogDebug;
+  else
+    return false;
+  return true;
+}
 
-  boost::property_tree::ptree node_root;
 
-  std::cout << "Write results to XML..." << std::endl;
 
-  // eng_info
-  node_root.add_child("eng_info", engInfoPropertyTree());
+// XML STREAM READER
 
-  // sim_params
-  node_root.add_child("sim_params", simParamsPropertyTree());
+namespace phys {
 
-  // DB locations
-  if (!dbl_data.empty())
-    node_root.add_child("physloc", dbLocPropertyTree());
+  // Minimal pull-style XML reader modelled after QXmlStreamReader as used by
+  // the SiQAD GUI. The input stream is consumed in fixed size chunks so memory
+  // use is bounded by the chunk size and the current element rather than the
+  // size of the document. Elements, attributes, character data and CDATA
+  // sections are reported; comments, processing instructions and DOCTYPE
+  // declarations are skipped.
+  class XMLStreamReader
+  {
+  public:
 
-  // DB electron distributions
-  if(!db_charge_data.empty())
-    node_root.add_child("elec_dist", dbChargePropertyTree());
+    enum TokenType{NoToken, StartElement, EndElement, Characters, EndDocument};
 
-  // electrode
-  if (!elec_data.empty())
-    node_root.add_child("electrode", electrodePropertyTree());
+    XMLStreamReader(std::istream &is, std::size_t chunk_size=1<<16)
+      : is(is), buf(chunk_size) {};
 
-  //electric potentials
-  if (!pot_data.empty())
-    node_root.add_child("potential_map", potentialPropertyTree());
+    // Read the next token and return its type.
+    TokenType readNext();
 
-  //potentials at db locations
-  if (!db_pot_data.empty())
-    node_root.add_child("dbdots", dbPotentialPropertyTree());
+    // Read until the next child start element of the current element. Return
+    // false if the end of the current element is reached instead.
+    bool readNextStartElement();
 
-  // SQCommands
-  if (!export_commands.empty()) {
-    std::cout << "export commands not empty, starting to fill them in." << std::endl;
-    node_root.add_child("sqcommands", sqCommandsPropertyTree());
-  }
+    // Read the character data of the current element, the reader is left at
+    // the corresponding end element.
+    std::string readElementText();
+
+    // Skip the remainder of the current element including all children.
+    void skipCurrentElement();
+
+    // Return the type of the current token.
+    TokenType tokenType() const {return token;}
+
+    // Return the name of the current start or end element.
+    const std::string &name() const {return elem_name;}
+
+    // Return whether the current start element has the given attribute.
+    bool hasAttribute(const std::string &key) const;
+
+    // Return the value of the given attribute of the current start element,
+    // throws if the attribute does not exist.
+    const std::string &attribute(const std::string &key) const;
 
-  // write full tree to file
-  boost::property_tree::ptree tree;
-  tree.add_child("sim_out", node_root);
-  boost::property_tree::write_xml(output_path, tree, std::locale(), boost::property_tree::xml_writer_make_settings<std::string>(' ',4));
+    // Return the character data of the current Characters token.
+    const std::string &text() const {return char_data;}
+
+    // Throw a std::runtime_error annotated with the current line number.
+    void raiseError(const std::string &msg) const;
+
+  private:
+
+    // Refill the buffer, return false at the end of the input stream.
+    bool fill();
+
+    // Get the next character or -1 at the end of the input stream.
+    int getChar()
+    {
+      if (pos == len && !fill())
+        return -1;
+      char c = buf[pos++];
+      if (c == '\n')
+        line++;
+      return static_cast<unsigned char>(c);
+    }
+
+    // Put the last character returned by getChar back (never a newline).
+    void ungetChar() {pos--;}
+
+    void expectChar(char expected);
+    void skipWhitespace();
+    void skipUntil(const std::string &terminator);
+    void readName(std::string &out);
+    void readEntity(std::string &out);
+
+    std::istream &is;
+    std::vector<char> buf;
+    std::size_t pos=0;
+    std::size_t len=0;
+    int line=1;
+
+    // current token
+    TokenType token=NoToken;
+    std::string elem_name;
+    std::vector<std::pair<std::string, std::string>> attrs;
+    std::size_t attr_count=0;     // attrs are reused between elements
+    std::string char_data;
+    bool pending_end=false;       // set by self-closing elements
+    int depth=0;
+  };
 
-  std::cout << "Write to XML complete." << std::endl;
 }
 
-bpt::ptree SiQADConnector::engInfoPropertyTree()
+XMLStreamReader::TokenType XMLStreamReader::readNext()
 {
-  boost::property_tree::ptree node_eng_info;
-  node_eng_info.put("engine", eng_name);
-  node_eng_info.put("version", "TBD"); // TODO real version
-  node_eng_info.put("return_code", std::to_string(return_code).c_str());
+  if (pending_end) {
+    pending_end = false;
+    depth--;
+    return token = EndElement;
+  }
 
-  //get timing information
-  end_time = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end_time-start_time;
-  std::time_t end = std::chrono::system_clock::to_time_t(end_time);
-  char* end_c_str = std::ctime(&end);
-  *std::remove(end_c_str, end_c_str+strlen(end_c_str), '\n') = '\0'; // removes _all_ new lines from the cstr
-  node_eng_info.put("timestamp", end_c_str);
-  node_eng_info.put("time_elapsed_s", std::to_string(elapsed_seconds.count()).c_str());
+  char_data.clear();
+  int c = getChar();
+  if (c == -1) {
+    if (depth != 0)
+      raiseError("Premature end of document");
+    return token = EndDocument;
+  }
+
+  // character data
+  if (c != '<') {
+    while (c != -1 && c != '<') {
+      if (c == '&')
+        readEntity(char_data);
+      else
+        char_data.push_back(static_cast<char>(c));
+      c = getChar();
+    }
+    if (c == '<')
+      ungetChar();
+    return token = Characters;
+  }
+
+  c = getChar();
+  if (c == '?') {
+    // processing instruction or XML declaration
+    skipUntil("?>");
+    return readNext();
+  } else if (c == '!') {
+    c = getChar();
+    if (c == '-') {
+      expectChar('-');
+      skipUntil("-->");
+      return readNext();
+    } else if (c == '[') {
+      for (const char *p = "CDATA["; *p; p++)
+        expectChar(*p);
+      const std::string term("]]>");
+      while (char_data.size() < term.size()
+          || char_data.compare(char_data.size()-term.size(), term.size(), term) != 0) {
+        c = getChar();
+        if (c == -1)
+          raiseError("Unterminated CDATA section");
+        char_data.push_back(static_cast<char>(c));
+      }
+      char_data.resize(char_data.size()-term.size());
+      return token = Characters;
+    }
+    // DOCTYPE declarations without internal subsets
+    skipUntil(">");
+    return readNext();
+  } else if (c == '/') {
+    readName(elem_name);
+    skipWhitespace();
+    expectChar('>');
+    depth--;
+    return token = EndElement;
+  }
 
-  return node_eng_info;
+  // start element
+  ungetChar();
+  readName(elem_name);
+  attr_count = 0;
+  while (true) {
+    skipWhitespace();
+    c = getChar();
+    if (c == '>') {
+      break;
+    } else if (c == '/') {
+      expectChar('>');
+      pending_end = true;
+      break;
+    } else if (c == -1) {
+      raiseError("Unterminated start element " + elem_name);
+    }
+    ungetChar();
+    if (attr_count == attrs.size())
+      attrs.resize(attr_count+1);
+    std::pair<std::string, std::string> &attr = attrs[attr_count++];
+    readName(attr.first);
+    skipWhitespace();
+    expectChar('=');
+    skipWhitespace();
+    int quote = getChar();
+    if (quote != '"' && quote != '\'')
+      raiseError("Expected quoted value for attribute " + attr.first);
+    attr.second.clear();
+    while ((c = getChar()) != quote) {
+      if (c == -1)
+        raiseError("Unterminated attribute value");
+      else if (c == '&')
+        readEntity(attr.second);
+      else
+        attr.second.push_back(static_cast<char>(c));
+    }
+  }
+  depth++;
+  return token = StartElement;
 }
 
-bpt::ptree SiQADConnector::simParamsPropertyTree()
+bool XMLStreamReader::readNextStartElement()
 {
-  bpt::ptree node_sim_params;
-  for (std::pair<std::string, std::string> param : sim_params)
-    node_sim_params.put(param.first, param.second);
-  return node_sim_params;
+  while (readNext() != EndDocument) {
+    if (token == StartElement)
+      return true;
+    else if (token == EndElement)
+      return false;
+  }
+  return false;
 }
 
-bpt::ptree SiQADConnector::dbLocPropertyTree()
+std::string XMLStreamReader::readElementText()
 {
-  bpt::ptree node_physloc;
-  for (unsigned int i = 0; i < dbl_data.size(); i++){
-    bpt::ptree node_dbdot;
-    node_dbdot.put("<xmlattr>.x", dbl_data[i].first.c_str());
-    node_dbdot.put("<xmlattr>.y", dbl_data[i].second.c_str());
-    node_physloc.add_child("dbdot", node_dbdot);
+  std::string result;
+  while (readNext() != EndElement) {
+    if (token == Characters)
+      result.append(char_data);
+    else
+      raiseError("Expected character data in element");
   }
-  return node_physloc;
+  return result;
 }
 
-bpt::ptree SiQADConnector::dbChargePropertyTree()
+void XMLStreamReader::skipCurrentElement()
 {
-  bpt::ptree node_elec_dist;
-  for (unsigned int i = 0; i < db_charge_data.size(); i++){
-    bpt::ptree node_dist;
-    node_dist.put("", db_charge_data[i][0]);
-    node_dist.put("<xmlattr>.energy", db_charge_data[i][1]);
-    node_dist.put("<xmlattr>.count", db_charge_data[i][2]);
-    node_elec_dist.add_child("dist", node_dist);
+  int d = 1;
+  while (d > 0) {
+    switch (readNext()) {
+      case StartElement:
+        d++;
+        break;
+      case EndElement:
+        d--;
+        break;
+      case EndDocument:
+        raiseError("Premature end of document");
+        break;
+      default:
+        break;
+    }
   }
-  return node_elec_dist;
 }
 
-bpt::ptree SiQADConnector::electrodePropertyTree()
+bool XMLStreamReader::hasAttribute(const std::string &key) const
+{
+  for (std::size_t i=0; i<attr_count; i++)
+    if (attrs[i].first == key)
+      return true;
+  return false;
+}
+
+const std::string &XMLStreamReader::attribute(const std::string &key) const
 {
-  bpt::ptree node_electrode;
-  for (unsigned int i = 0; i < elec_data.size(); i++){
-    boost::property_tree::ptree node_dim;
-    node_dim.put("<xmlattr>.x1", elec_data[i][0].c_str());
-    node_dim.put("<xmlattr>.y1", elec_data[i][1].c_str());
-    node_dim.put("<xmlattr>.x2", elec_data[i][2].c_str());
-    node_dim.put("<xmlattr>.y2", elec_data[i][3].c_str());
-    node_electrode.add_child("dim", node_dim);
-    boost::property_tree::ptree node_pot;
-    node_pot.put("", elec_data[i][4].c_str());
-    node_electrode.add_child("potential", node_pot);
+  for (std::size_t i=0; i<attr_count; i++)
+    if (attrs[i].first == key)
+      return attrs[i].second;
+  raiseError("Attribute " + key + " not found in element " + elem_name);
+  return elem_name; // never reached
+}
+
+void XMLStreamReader::raiseError(const std::string &msg) const
+{
+  throw std::runtime_error("XML error on line " + std::to_string(line) + ": " + msg);
+}
+
+bool XMLStreamReader::fill()
+{
+  if (!is)
+    return false;
+  is.read(buf.data(), buf.size());
+  len = static_cast<std::size_t>(is.gcount());
+  pos = 0;
+  return len > 0;
+}
+
+void XMLStreamReader::expectChar(char expected)
+{
+  if (getChar() != static_cast<unsigned char>(expected))
+    raiseError(std::string("Expected '") + expected + "'");
+}
+
+void XMLStreamReader::skipWhitespace()
+{
+  int c;
+  while ((c = getChar()) != -1) {
+    if (!std::isspace(c)) {
+      ungetChar();
+      return;
+    }
   }
-  return node_electrode;
 }
 
-bpt::ptree SiQADConnector::potentialPropertyTree()
+void XMLStreamReader::skipUntil(const std::string &terminator)
 {
-  bpt::ptree node_potential_map;
-  for (unsigned int i = 0; i < pot_data.size(); i++){
-    boost::property_tree::ptree node_potential_val;
-    node_potential_val.put("<xmlattr>.x", pot_data[i][0].c_str());
-    node_potential_val.put("<xmlattr>.y", pot_data[i][1].c_str());
-    node_potential_val.put("<xmlattr>.val", pot_data[i][2].c_str());
-    node_potential_map.add_child("potential_val", node_potential_val);
+  // keep a window of the last read characters the size of the terminator
+  std::string window;
+  int c;
+  while ((c = getChar()) != -1) {
+    window.push_back(static_cast<char>(c));
+    if (window.size() > terminator.size())
+      window.erase(0, 1);
+    if (window == terminator)
+      return;
   }
-  return node_potential_map;
+  raiseError("Expected '" + terminator + "' before end of document");
 }
 
-bpt::ptree SiQADConnector::dbPotentialPropertyTree()
+void XMLStreamReader::readName(std::string &out)
 {
-  bpt::ptree node_dbdots;
-  for (unsigned int i = 0; i < db_pot_data.size(); i++){
-    bpt::ptree node_dbdot;
-    bpt::ptree node_physloc;
-    boost::property_tree::ptree node_db_step;
-    node_db_step.put("", db_pot_data[i][0].c_str());
-    node_dbdot.add_child("step", node_db_step);
-    node_physloc.put("<xmlattr>.x", db_pot_data[i][1].c_str());
-    node_physloc.put("<xmlattr>.y", db_pot_data[i][2].c_str());
-    node_dbdot.add_child("physloc", node_physloc);
-    boost::property_tree::ptree node_db_pot;
-    node_db_pot.put("", db_pot_data[i][3].c_str());
-    node_dbdot.add_child("potential", node_db_pot);
-    node_dbdots.add_child("dbdot", node_dbdot);
+  out.clear();
+  int c;
+  while ((c = getChar()) != -1) {
+    if (std::isspace(c) || c == '/' || c == '>' || c == '=') {
+      ungetChar();
+      break;
+    }
+    out.push_back(static_cast<char>(c));
   }
-  return node_dbdots;
+  if (out.empty())
+    raiseError("Expected element or attribute name");
 }
 
-bpt::ptree SiQADConnector::sqCommandsPropertyTree()
+void XMLStreamReader::readEntity(std::string &out)
 {
-  bpt::ptree node_sqcommands;
-  for (unsigned int i = 0; i < export_commands.size(); i++) {
-    std::cout << "command " << i << ": ";
-    std::cout << export_commands.at(i) << std::endl;
-    bpt::ptree node_sqc;
-    node_sqc.put("", export_commands.at(i).c_str());
-    //std::cout << export_commands.at(i)->finalCommand() << std::endl;
-    node_sqcommands.add_child("sqc", node_sqc);
+  std::string ent;
+  int c;
+  while ((c = getChar()) != ';') {
+    if (c == -1 || ent.size() > 8)
+      raiseError("Malformed entity reference");
+    ent.push_back(static_cast<char>(c));
+  }
+
+  if (ent == "lt") {
+    out.push_back('<');
+  } else if (ent == "gt") {
+    out.push_back('>');
+  } else if (ent == "amp") {
+    out.push_back('&');
+  } else if (ent == "quot") {
+    out.push_back('"');
+  } else if (ent == "apos") {
+    out.push_back('\'');
+  } else if (ent.size() > 1 && ent[0] == '#') {
+    unsigned long cp = (ent[1] == 'x') ? std::stoul(ent.substr(2), nullptr, 16)
+                                       : std::stoul(ent.substr(1));
+    // encode the code point as UTF-8
+    if (cp < 0x80) {
+      out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+      out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+      out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  } else {
+    raiseError("Unknown entity &" + ent + ";");
   }
-  return node_sqcommands;
 }
 
-//DB ITERATOR
 
-DBIterator::DBIterator(std::shared_ptr<Aggregate> root, bool begin)
+
+// FILE HANDLING
+// parse problem XML, throws if the problem file cannot be read
+void SiQADConnector::readProblem(const std::string &path)
 {
-  if(begin){
-    // keep finding deeper aggregates until one that contains dbs is found
-    while(root->dbs.empty() && !root->aggs.empty()) {
-      push(root);
-      root = root->aggs.front();
+  log(LogInfo) << "Reading problem file: " << input_path << '\n';
+
+  std::ifstream in_file(path, std::ios::in | std::ios::binary);
+  if (!in_file)
+    throw std::runtime_error("Unable to open problem file " + path);
+  XMLStreamReader rs(in_file);
+
+  // enter root node
+  if (!rs.readNextStartElement() || rs.name() != "siqad")
+    rs.raiseError("Problem file root element must be siqad");
+
+  bool sim_params_read=false, layers_read=false, design_read=false;
+  while (rs.readNextStartElement()) {
+    if (rs.name() == "program") {
+      // TODO read program node
+      rs.skipCurrentElement();
+    } else if (rs.name() == "sim_params") {
+      // read simulation parameters
+      log(LogInfo) << "Read simulation parameters" << '\n';
+      readSimulationParam(rs);
+      sim_params_read = true;
+    } else if (rs.name() == "layers") {
+      // read layer properties
+      log(LogInfo) << "Read layer properties" << '\n';
+      readLayers(rs);
+      layers_read = true;
+    } else if (rs.name() == "design") {
+      // read items
+      log(LogInfo) << "Read items tree" << '\n';
+      readDesign(rs, item_tree);
+      design_read = true;
+    } else {
+      rs.skipCurrentElement();
     }
-    push(root);
   }
-  else{
-    db_iter = root->dbs.cend();
+
+  if (!sim_params_read || !layers_read || !design_read)
+    throw std::runtime_error("Problem file " + path
+        + " must contain sim_params, layers and design nodes");
+}
+
+void SiQADConnector::readProgramProp(XMLStreamReader &rs)
+{
+  while (rs.readNextStartElement()) {
+    std::string key = rs.name();
+    program_props.insert(std::map<std::string, std::string>::value_type(key, rs.readElementText()));
+    if (logEnabled(LogDebug))
+      log(LogDebug) << "ProgramProp: Key=" << key << ", Value=" << program_props[key] << '\n';
   }
 }
 
-DBIterator& DBIterator::operator++()
+void SiQADConnector::readLayers(XMLStreamReader &rs)
 {
-  // exhaust the current Aggregate DBs first
-  if(db_iter != curr->dbs.cend())
-    return ++db_iter != curr->dbs.cend() ? *this : ++(*this);
+  while (rs.readNextStartElement())
+    readLayerProp(rs);
+}
 
-  // if available, push the next aggregate onto the stack
-  if(agg_stack.top().second != curr->aggs.cend()){
-    push(*agg_stack.top().second);
-    return db_iter != curr->dbs.cend() ? *this : ++(*this);
+void SiQADConnector::readLayerProp(XMLStreamReader &rs)
+{
+  Layer lay;
+  bool has_name=false, has_type=false, has_zoffset=false, has_zheight=false;
+  while (rs.readNextStartElement()) {
+    if (rs.name() == "name") {
+      lay.name = rs.readElementText();
+      has_name = true;
+    } else if (rs.name() == "type") {
+      lay.type = rs.readElementText();
+      has_type = true;
+    } else if (rs.name() == "zoffset") {
+      lay.zoffset = std::stof(rs.readElementText());
+      has_zoffset = true;
+    } else if (rs.name() == "zheight") {
+      lay.zheight = std::stof(rs.readElementText());
+      has_zheight = true;
+    } else if (rs.name() == "lat_vec") {
+      readLatticeVectors(rs);
+    } else {
+      rs.skipCurrentElement();
+    }
   }
+  if (!has_name || !has_type || !has_zoffset || !has_zheight)
+    rs.raiseError("Layer properties must include name, type, zoffset and zheight");
 
-  // aggregate is complete, pop off stack
-  pop();
-  return agg_stack.size() == 0 ? *this : ++(*this);
+  layers.push_back(lay);
+  log(LogInfo) << "Retrieved layer " << lay.name << " of type " << lay.type << '\n';
 }
 
-void DBIterator::push(std::shared_ptr<Aggregate> agg)
+
+void SiQADConnector::readLatticeVectors(XMLStreamReader &rs)
 {
-  if(!agg_stack.empty())
-    ++agg_stack.top().second;
-  agg_stack.push(std::make_pair(agg, agg->aggs.cbegin()));
-  db_iter = agg->dbs.cbegin();
-  curr = agg;
+  Lattice lat;
+  lat.b.clear();
+  int n_cell = -1;
+  while (rs.readNextStartElement()) {
+    const std::string &name = rs.name();
+    if (name == "N") {
+      n_cell = std::stoi(rs.readElementText());
+      continue;
+    }
+    std::pair<double, double> vec(std::stod(rs.attribute("x")), std::stod(rs.attribute("y")));
+    if (name == "a1") {
+      lat.a1 = vec;
+    } else if (name == "a2") {
+      lat.a2 = vec;
+    } else if (name.size() > 1 && name[0] == 'b') {
+      // site offsets b1 ... bN
+      std::size_t ind = std::stoul(name.substr(1)) - 1;
+      if (lat.b.size() <= ind)
+        lat.b.resize(ind+1);
+      lat.b[ind] = vec;
+    }
+    rs.skipCurrentElement();
+  }
+  if (n_cell != static_cast<int>(lat.b.size()))
+    rs.raiseError("Lattice cell site count does not match the number of site offsets");
+
+  lattice = lat;
+  log(LogInfo) << "Retrieved lattice with " << n_cell << " sites per unit cell" << '\n';
 }
 
-void DBIterator::pop()
+void SiQADConnector::readSimulationParam(XMLStreamReader &rs)
 {
-  agg_stack.pop();              // pop complete aggregate off stack
-  if(agg_stack.size() > 0){
-    curr = agg_stack.top().first; // update current to new top
-    db_iter = curr->dbs.cend();   // don't reread dbs
+  while (rs.readNextStartElement()) {
+    std::string key = rs.name();
+    sim_params.insert(std::map<std::string, std::string>::value_type(key, rs.readElementText()));
+    if (logEnabled(LogDebug))
+      log(LogDebug) << "SimParam: Key=" << key << ", Value=" << sim_params[key] << '\n';
+  }
+
+  parseParameters();
+
+  auto param_log_level = sim_params.find("log_level");
+  if (param_log_level != sim_params.end() && !log_level_from_env
+      && !setLogLevel(param_log_level->second))
+    std::cerr << "Unknown log_level " << param_log_level->second << std::endl;
+}
+
+void SiQADConnector::readDesign(XMLStreamReader &rs, const std::shared_ptr<Aggregate> &agg_parent)
+{
+  log(LogInfo) << "Beginning to read design" << '\n';
+  while (rs.readNextStartElement()) {
+    std::string layer_name = rs.name();
+    std::string layer_type = rs.attribute("type");
+    if ((!layer_type.compare("DB"))) {
+      log(LogInfo) << "Encountered node " << layer_name << " with type " << layer_type << ", entering" << '\n';
+      readItemTree(rs, agg_parent);
+    } else if ( (!layer_type.compare("Electrode"))) {
+      log(LogInfo) << "Encountered node " << layer_name << " with type " << layer_type << ", entering" << '\n';
+      readItemTree(rs, agg_parent);
+    } else {
+      log(LogInfo) << "Encountered node " << layer_name << " with type " << layer_type << ", no defined action for this layer. Skipping." << '\n';
+      rs.skipCurrentElement();
+    }
+  }
+}
+
+void SiQADConnector::readItemTree(XMLStreamReader &rs, const std::shared_ptr<Aggregate> &agg_parent)
+{
+  while (rs.readNextStartElement()) {
+    const std::string &item_name = rs.name();
+    if (logEnabled(LogDebug))
+      log(LogDebug) << "item_name: " << item_name << '\n';
+    if (!item_name.compare("aggregate")) {
+      // add aggregate child to tree
+      agg_parent->aggs.push_back(std::make_shared<Aggregate>());
+      readItemTree(rs, agg_parent->aggs.back());
+    } else if (!item_name.compare("dbdot")) {
+      // add DBDot to tree
+      readDBDot(rs, agg_parent);
+    } else if (!item_name.compare("electrode")) {
+      // add Electrode to tree
+      readElectrode(rs, agg_parent);
+    } else if (!item_name.compare("electrode_poly")) {
+      // add Electrode to tree
+      readElectrodePoly(rs, agg_parent);
+    } else {
+      log(LogInfo) << "Encountered unknown item node: " << item_name << '\n';
+      rs.skipCurrentElement();
+    }
+  }
+}
+
+// Read the <key><val>...</val></key> children of an electrode property_map.
+static std::map<std::string, std::string> readElectrodePropertyMap(XMLStreamReader &rs)
+{
+  std::map<std::string, std::string> props;
+  while (rs.readNextStartElement()) {
+    std::string key = rs.name();
+    while (rs.readNextStartElement()) {
+      if (rs.name() == "val")
+        props[key] = rs.readElementText();
+      else
+        rs.skipCurrentElement();
+    }
   }
+  return props;
+}
+
+// Return the electrode property with the given key, throws if not found.
+static const std::string &electrodeProperty(XMLStreamReader &rs,
+    const std::map<std::string, std::string> &props, const std::string &key)
+{
+  auto it = props.find(key);
+  if (it == props.end())
+    rs.raiseError("Electrode property_map is missing " + key);
+  return it->second;
+}
+
+void SiQADConnector::readElectrode(XMLStreamReader &rs, const std::shared_ptr<Aggregate> &agg_parent)
+{
+  double x1=0, x2=0, y1=0, y2=0, pixel_per_angstrom=0, potential, phase, angle=0;
+  int layer_id=0, electrode_type=0, net;
+  bool has_layer_id=false, has_angle=false, has_ppa=false, has_dim=false;
+  std::map<std::string, std::string> props;
+  // read values from XML stream
+  while (rs.readNextStartElement()) {
+    if (rs.name() == "layer_id") {
+      layer_id = std::stoi(rs.readElementText());
+      has_layer_id = true;
+    } else if (rs.name() == "angle") {
+      angle = std::stod(rs.readElementText());
+      has_angle = true;
+    } else if (rs.name() == "pixel_per_angstrom") {
+      pixel_per_angstrom = std::stod(rs.readElementText());
+      has_ppa = true;
+    } else if (rs.name() == "dim") {
+      x1 = std::stod(rs.attribute("x1"));
+      x2 = std::stod(rs.attribute("x2"));
+      y1 = std::stod(rs.attribute("y1"));
+      y2 = std::stod(rs.attribute("y2"));
+      has_dim = true;
+      rs.skipCurrentElement();
+    } else if (rs.name() == "property_map") {
+      props = readElectrodePropertyMap(rs);
+    } else {
+      rs.skipCurrentElement();
+    }
+  }
+  if (!has_layer_id || !has_angle || !has_ppa || !has_dim)
+    rs.raiseError("Electrode must include layer_id, angle, pixel_per_angstrom and dim");
+
+  potential = std::stod(electrodeProperty(rs, props, "potential"));
+  phase = std::stod(electrodeProperty(rs, props, "phase"));
+  std::string electrode_type_s = electrodeProperty(rs, props, "type");
+  if (!electrode_type_s.compare("fixed")){
+    electrode_type = 0;
+  } else if (!electrode_type_s.compare("clocked")) {
+    electrode_type = 1;
+  }
+  net = std::stoi(electrodeProperty(rs, props, "net"));
+  agg_parent->elecs.push_back(std::make_shared<Electrode>(layer_id,x1,x2,y1,y2,potential,phase,electrode_type,pixel_per_angstrom,net,angle));
+  if (props.count("pot_offset"))
+    agg_parent->elecs.back()->pot_offset = std::stod(props["pot_offset"]);
+
+  if (logEnabled(LogDebug))
+    log(LogDebug) << "Electrode created with x1=" << agg_parent->elecs.back()->x1 << ", y1=" << agg_parent->elecs.back()->y1 <<
+      ", x2=" << agg_parent->elecs.back()->x2 << ", y2=" << agg_parent->elecs.back()->y2 <<
+      ", potential=" << agg_parent->elecs.back()->potential << '\n';
+}
+
+void SiQADConnector::readElectrodePoly(XMLStreamReader &rs, const std::shared_ptr<Aggregate> &agg_parent)
+{
+  double pixel_per_angstrom=0, potential, phase;
+  std::vector<std::pair<double, double>> vertices;
+  int layer_id=0, electrode_type=0, net;
+  bool has_layer_id=false, has_ppa=false;
+  std::map<std::string, std::string> props;
+  // read values from XML stream, cycling through the vertices
+  while (rs.readNextStartElement()) {
+    if (rs.name() == "layer_id") {
+      layer_id = std::stoi(rs.readElementText());
+      has_layer_id = true;
+    } else if (rs.name() == "pixel_per_angstrom") {
+      pixel_per_angstrom = std::stod(rs.readElementText());
+      has_ppa = true;
+    } else if (rs.name() == "vertex") {
+      double x = std::stod(rs.attribute("x"));
+      double y = std::stod(rs.attribute("y"));
+      vertices.push_back(std::make_pair(x, y));
+      rs.skipCurrentElement();
+    } else if (rs.name() == "property_map") {
+      props = readElectrodePropertyMap(rs);
+    } else {
+      rs.skipCurrentElement();
+    }
+  }
+  if (!has_layer_id || !has_ppa)
+    rs.raiseError("ElectrodePoly must include layer_id and pixel_per_angstrom");
+
+  potential = std::stod(electrodeProperty(rs, props, "potential"));
+  phase = std::stod(electrodeProperty(rs, props, "phase"));
+  std::string electrode_type_s = electrodeProperty(rs, props, "type");
+  if (!electrode_type_s.compare("fixed")){
+    electrode_type = 0;
+  } else if (!electrode_type_s.compare("clocked")) {
+    electrode_type = 1;
+  }
+  net = std::stoi(electrodeProperty(rs, props, "net"));
+  agg_parent->elec_polys.push_back(std::make_shared<ElectrodePoly>(layer_id,vertices,potential,phase,electrode_type,pixel_per_angstrom,net));
+  if (props.count("pot_offset"))
+    agg_parent->elec_polys.back()->pot_offset = std::stod(props["pot_offset"]);
+
+  if (logEnabled(LogDebug))
+    log(LogDebug) << "ElectrodePoly created with " << agg_parent->elec_polys.back()->vertices.size() <<
+      " vertices, potential=" << agg_parent->elec_polys.back()->potential << '\n';
+}
+
+void SiQADConnector::readDBDot(XMLStreamReader &rs, const std::shared_ptr<Aggregate> &agg_parent)
+{
+  float x=0, y=0;
+  int n=0, m=0, l=0;
+  bool has_physloc=false, has_latcoord=false;
+
+  while (rs.readNextStartElement()) {
+    if (rs.name() == "physloc") {
+      // read x and y physical locations
+      x = std::stof(rs.attribute("x"));
+      y = std::stof(rs.attribute("y"));
+      has_physloc = true;
+    } else if (rs.name() == "latcoord") {
+      // read n, m and l lattice coordinates
+      n = std::stoi(rs.attribute("n"));
+      m = std::stoi(rs.attribute("m"));
+      l = std::stoi(rs.attribute("l"));
+      has_latcoord = true;
+    }
+    rs.skipCurrentElement();
+  }
+  if (!has_physloc || !has_latcoord)
+    rs.raiseError("DBDot must include physloc and latcoord");
+
+  agg_parent->dbs.push_back(std::make_shared<DBDot>(x, y, n, m, l));
+
+  if (logEnabled(LogDebug))
+    log(LogDebug) << "DBDot created with x=" << agg_parent->dbs.back()->x
+                  << ", y=" << agg_parent->dbs.back()->y
+                  << ", n=" << agg_parent->dbs.back()->n
+                  << ", m=" << agg_parent->dbs.back()->m
+                  << ", l=" << agg_parent->dbs.back()->l
+                  << '\n';
+}
+
+void SiQADConnector::accumulateDBCharge(const int8_t *charges, std::size_t n_dbs,
+    double energy, int physically_valid)
+{
+  charge_configs.add(charges, n_dbs, energy, physically_valid);
+}
+
+void SiQADConnector::accumulateDBCharge(const std::string &dist, double energy,
+    int physically_valid)
+{
+  std::vector<int8_t> charges(dist.size());
+  for (std::size_t i = 0; i < dist.size(); i++) {
+    switch (dist[i]) {
+      case '-': charges[i] = -1; break;
+      case '0': charges[i] = 0; break;
+      case '+': charges[i] = 1; break;
+      default:
+        throw std::invalid_argument(std::string("Unrecognized charge '") + dist[i]
+            + "' in charge configuration " + dist);
+    }
+  }
+  charge_configs.add(charges.data(), charges.size(), energy, physically_valid);
+}
+
+void SiQADConnector::setChargeConfigLimit(std::size_t max_configs)
+{
+  charge_configs.setLimit(max_configs);
+  std::lock_guard<std::mutex> lock(result_buffers_mutex);
+  for (auto &buffer : result_buffers)
+    buffer->charge_configs.setLimit(max_configs);
+}
+
+std::size_t SiQADConnector::distinctChargeConfigCount() const
+{
+  return charge_configs.size();
+}
+
+std::shared_ptr<ResultBuffer> SiQADConnector::createResultBuffer()
+{
+  std::shared_ptr<ResultBuffer> buffer = std::make_shared<ResultBuffer>();
+  buffer->charge_configs.setLimit(charge_configs.limit());
+  std::lock_guard<std::mutex> lock(result_buffers_mutex);
+  result_buffers.push_back(buffer);
+  return buffer;
+}
+
+void SiQADConnector::mergeResultBuffers()
+{
+  std::lock_guard<std::mutex> lock(result_buffers_mutex);
+  for (auto &buffer : result_buffers) {
+    charge_configs.merge(buffer->charge_configs);
+    buffer->charge_configs.clear();
+    export_commands.insert(export_commands.end(),
+        buffer->export_commands.begin(), buffer->export_commands.end());
+    buffer->export_commands.clear();
+  }
+}
+
+void ResultBuffer::addSQCommand(SQCommand *command)
+{
+  export_commands.push_back(command->finalCommand());
+}
+
+// SIMULATION PARAMETERS
+
+// Throw unless a parameter value could be converted as requested.
+static void requireConversion(bool ok, const std::string &key,
+    const std::string &val, const char *type_name)
+{
+  if (!ok)
+    throw std::invalid_argument("Simulation parameter " + key + " = '" + val
+        + "' is not a valid " + type_name);
+}
+
+static std::invalid_argument missingParameter(const std::string &key)
+{
+  return std::invalid_argument("Simulation parameter " + key + " is missing");
+}
+
+double SiQADConnector::getDouble(const std::string &key) const
+{
+  const ParamValue *param = findParameter(key);
+  if (!param)
+    throw missingParameter(key);
+  requireConversion(param->is_double, key, param->str, "number");
+  return param->d;
+}
+
+double SiQADConnector::getDouble(const std::string &key, double default_val) const
+{
+  return findParameter(key) ? getDouble(key) : default_val;
+}
+
+int SiQADConnector::getInt(const std::string &key) const
+{
+  const ParamValue *param = findParameter(key);
+  if (!param)
+    throw missingParameter(key);
+  requireConversion(param->is_int, key, param->str, "integer");
+  return param->i;
+}
+
+int SiQADConnector::getInt(const std::string &key, int default_val) const
+{
+  return findParameter(key) ? getInt(key) : default_val;
+}
+
+int SiQADConnector::getEnum(const std::string &key,
+    const std::vector<std::string> &options) const
+{
+  const ParamValue *param = findParameter(key);
+  if (!param)
+    throw missingParameter(key);
+  auto it = std::find(options.begin(), options.end(), param->str);
+  if (it == options.end())
+    throw std::invalid_argument("Simulation parameter " + key + " = '"
+        + param->str + "' is not one of " + boost::algorithm::join(options, ", "));
+  return static_cast<int>(it - options.begin());
+}
+
+int SiQADConnector::getEnum(const std::string &key,
+    const std::vector<std::string> &options, int default_index) const
+{
+  return findParameter(key) ? getEnum(key, options) : default_index;
+}
+
+void SiQADConnector::loadParameterSchema(const std::string &plugin_path)
+{
+  std::ifstream in_file(plugin_path, std::ios::in | std::ios::binary);
+  if (!in_file)
+    throw std::runtime_error(std::string("Unable to open plugin file ") + plugin_path);
+
+  std::map<std::string, ParamDef> schema;
+  XMLStreamReader rs(in_file);
+  if (!rs.readNextStartElement())
+    rs.raiseError("Expected plugin element");
+  while (rs.readNextStartElement()) {
+    if (rs.name() != "sim_params") {
+      rs.skipCurrentElement();
+      continue;
+    }
+    while (rs.readNextStartElement()) {
+      std::string key = rs.name();
+      ParamDef &def = schema[key];
+      while (rs.readNextStartElement()) {
+        if (rs.name() == "T") {
+          def.type = rs.readElementText();
+        } else if (rs.name() == "val") {
+          def.default_val = rs.readElementText();
+        } else if (rs.name() == "value_selection" && rs.hasAttribute("type")
+            && rs.attribute("type") == "ComboBox") {
+          while (rs.readNextStartElement()) {
+            def.options.push_back(rs.name());
+            rs.skipCurrentElement();
+          }
+        } else {
+          rs.skipCurrentElement();
+        }
+      }
+      if (def.type != "bool" && def.type != "int" && def.type != "float"
+          && def.type != "double" && def.type != "string")
+        throw std::invalid_argument("Parameter " + key + " in " + plugin_path
+            + " has unsupported type '" + def.type + "'");
+      checkParameter(key, def.default_val, def);
+    }
+  }
+  log(LogInfo) << "Read " << schema.size() << " parameter definitions from "
+    << plugin_path << '\n';
+
+  param_schema = schema;
+  param_schema_loaded = true;
+  parseParameters();
+  for (std::size_t i=0; i<variants.size(); i++) {
+    std::map<std::string, std::string> params = base_sim_params;
+    for (const auto &param : variants[i].overrides)
+      params[param.first] = param.second;
+    try {
+      validateParameters(params);
+    } catch (const std::invalid_argument &e) {
+      throw std::invalid_argument("Variant " + std::to_string(i) + ": " + e.what());
+    }
+  }
+}
+
+std::map<std::string, std::string> SiQADConnector::getAllParameters()
+{
+  std::map<std::string, std::string> params;
+  for (const auto &param : typed_params)
+    params[param.first] = param.second.str;
+  return params;
+}
+
+void SiQADConnector::parseParameters()
+{
+  validateParameters(sim_params);
+  typed_params.clear();
+  for (const auto &def : param_schema)
+    typed_params[def.first] = parseParamValue(def.second.default_val);
+  for (const auto &param : sim_params)
+    typed_params[param.first] = parseParamValue(param.second);
+}
+
+void SiQADConnector::validateParameters(const std::map<std::string, std::string> &params) const
+{
+  if (!param_schema_loaded)
+    return;
+  for (const auto &param : params) {
+    // read by the connector itself
+    if (param.first == "log_level")
+      continue;
+    auto def = param_schema.find(param.first);
+    if (def == param_schema.end())
+      throw std::invalid_argument("Simulation parameter " + param.first
+          + " is not defined by the plugin");
+    checkParameter(param.first, param.second, def->second);
+  }
+}
+
+const SiQADConnector::ParamValue *SiQADConnector::findParameter(const std::string &key) const
+{
+  auto it = typed_params.find(key);
+  return it != typed_params.end() ? &it->second : nullptr;
+}
+
+SiQADConnector::ParamValue SiQADConnector::parseParamValue(const std::string &str)
+{
+  ParamValue param;
+  param.str = str;
+  const char *begin = str.c_str();
+  auto parsedAll = [](const char *end)
+  {
+    while (std::isspace(static_cast<unsigned char>(*end)))
+      end++;
+    return *end == '\0';
+  };
+  char *end;
+  errno = 0;
+  param.d = std::strtod(begin, &end);
+  param.is_double = end != begin && parsedAll(end) && errno != ERANGE;
+  errno = 0;
+  long l = std::strtol(begin, &end, 10);
+  param.is_int = end != begin && parsedAll(end) && errno != ERANGE
+    && l >= std::numeric_limits<int>::min() && l <= std::numeric_limits<int>::max();
+  param.i = param.is_int ? static_cast<int>(l) : 0;
+  return param;
+}
+
+void SiQADConnector::checkParameter(const std::string &key, const std::string &val,
+    const ParamDef &def)
+{
+  if (def.type == "bool") {
+    requireConversion(val == "0" || val == "1" || val == "true" || val == "false",
+        key, val, def.type.c_str());
+  } else if (def.type == "int") {
+    requireConversion(parseParamValue(val).is_int, key, val, def.type.c_str());
+  } else if (def.type == "float" || def.type == "double") {
+    requireConversion(parseParamValue(val).is_double, key, val, def.type.c_str());
+  }
+  if (!def.options.empty()
+      && std::find(def.options.begin(), def.options.end(), val) == def.options.end())
+    throw std::invalid_argument("Simulation parameter " + key + " = '" + val
+        + "' is not one of " + boost::algorithm::join(def.options, ", "));
+}
+
+
+// BATCH MODE
+
+void SiQADConnector::addVariant(const std::map<std::string, std::string> &overrides,
+    const std::string &t_output_path)
+{
+  if (param_schema_loaded) {
+    std::map<std::string, std::string> params = base_sim_params;
+    for (const auto &param : overrides)
+      params[param.first] = param.second;
+    try {
+      validateParameters(params);
+    } catch (const std::invalid_argument &e) {
+      throw std::invalid_argument("Variant " + std::to_string(variants.size())
+          + ": " + e.what());
+    }
+  }
+
+  Variant variant;
+  variant.overrides = overrides;
+  variant.output_path = t_output_path;
+  if (variant.output_path.empty()) {
+    // insert the variant index before the extension of the base output path
+    std::string::size_type ext = base_output_path.find_last_of('.');
+    std::string::size_type dir = base_output_path.find_last_of("/\\");
+    if (ext == std::string::npos || (dir != std::string::npos && ext < dir))
+      ext = base_output_path.size();
+    variant.output_path = base_output_path.substr(0, ext) + "_"
+      + std::to_string(variants.size()) + base_output_path.substr(ext);
+  }
+  variants.push_back(variant);
+}
+
+void SiQADConnector::readVariants(const std::string &path)
+{
+  std::ifstream in_file(path, std::ios::in | std::ios::binary);
+  if (!in_file)
+    throw std::runtime_error(std::string("Unable to open variants file ") + path);
+
+  XMLStreamReader rs(in_file);
+  if (!rs.readNextStartElement() || rs.name() != "variants")
+    rs.raiseError("Expected variants element");
+  while (rs.readNextStartElement()) {
+    if (rs.name() == "variant") {
+      std::string variant_output = rs.hasAttribute("output_path") ?
+        rs.attribute("output_path") : std::string();
+      std::map<std::string, std::string> overrides;
+      while (rs.readNextStartElement()) {
+        std::string key = rs.name();
+        overrides[key] = rs.readElementText();
+      }
+      addVariant(overrides, variant_output);
+    } else {
+      log(LogInfo) << "Ignoring unrecognized variants element " << rs.name() << '\n';
+      rs.skipCurrentElement();
+    }
+  }
+  log(LogInfo) << "Read " << variants.size() << " variants from " << path << std::endl;
+}
+
+void SiQADConnector::beginVariant(std::size_t index)
+{
+  const Variant &variant = variants.at(index);
+
+  // results of the previous variant, or of the base problem if anything was
+  // exported before the first variant
+  if (current_variant != -1 || result_stream || hasPendingResults())
+    writeResultsXml();
+
+  std::map<std::string, std::string> prev_params = sim_params;
+  sim_params = base_sim_params;
+  for (const auto &param : variant.overrides)
+    sim_params[param.first] = param.second;
+  parseParameters();
+  output_path = variant.output_path;
+  current_variant = static_cast<int>(index);
+  resetResults();
+
+  // only DB interactions depend on simulation parameters
+  auto paramChanged = [&](const std::string &key)
+  {
+    auto prev = prev_params.find(key);
+    auto curr = sim_params.find(key);
+    if (prev == prev_params.end() || curr == sim_params.end())
+      return prev != prev_params.end() || curr != sim_params.end();
+    return prev->second != curr->second;
+  };
+  if (paramChanged("eps_r") || paramChanged("debye_length")) {
+    std::lock_guard<std::mutex> lock(pairwise_mutex);
+    db_interaction_mat.reset();
+    db_interaction_mat_f.reset();
+    lattice_kernel.reset();
+  }
+}
+
+void SiQADConnector::resetResults()
+{
+  pot_data.clear();
+  db_pot_data.clear();
+  elec_data.clear();
+  dbl_data.clear();
+  db_charge_data.clear();
+  export_commands.clear();
+  typed_exports.clear();
+  charge_export = ChargeExport();
+  charge_configs.clear();
+  {
+    std::lock_guard<std::mutex> lock(result_buffers_mutex);
+    for (auto &buffer : result_buffers) {
+      buffer->charge_configs.clear();
+      buffer->export_commands.clear();
+    }
+  }
+  result_stream.reset();
+  results_finalized = false;
+  return_code = 0;
+  start_time = std::chrono::system_clock::now();
+
+  // phases still open are timed from now on
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  phases.erase(std::remove_if(phases.begin(), phases.end(),
+        [](const Phase &p) {return p.depth == 0;}), phases.end());
+  for (Phase &phase : phases) {
+    phase.elapsed = 0;
+    phase.start = std::chrono::steady_clock::now();
+  }
+}
+
+bool SiQADConnector::hasPendingResults()
+{
+  if (!pot_data.empty() || !db_pot_data.empty() || !elec_data.empty()
+      || !dbl_data.empty() || !db_charge_data.empty() || !export_commands.empty()
+      || !typed_exports.empty() || !charge_export.charges.empty()
+      || !charge_configs.empty())
+    return true;
+  std::lock_guard<std::mutex> lock(result_buffers_mutex);
+  for (const auto &buffer : result_buffers)
+    if (!buffer->charge_configs.empty() || !buffer->export_commands.empty())
+      return true;
+  return false;
+}
+
+// XML STREAM WRITER
+
+namespace phys {
+
+  // Minimal XML writer counterpart of XMLStreamReader, modelled after
+  // QXmlStreamWriter with auto formatting. Numbers are formatted into a stack
+  // buffer and written straight to the output stream so that large numeric
+  // results never exist as strings.
+  class XMLStreamWriter
+  {
+  public:
+
+    XMLStreamWriter(std::ostream &os, int indent=4)
+      : os(os), indent(indent) {};
+
+    // Write the XML declaration.
+    void writeStartDocument() {os << "<?xml version=\"1.0\" encoding=\"utf-8\"?>";}
+
+    // Close all open elements.
+    void writeEndDocument();
+
+    // Open a new element, attributes may be written until content is added.
+    void writeStartElement(const char *name);
+
+    // Write an attribute to the element that was just opened.
+    void writeAttribute(const char *name, const std::string &value);
+    void writeAttribute(const char *name, double value);
+    void writeAttribute(const char *name, float value);
+    void writeAttribute(const char *name, int value);
+
+    // Write character data to the current element.
+    void writeCharacters(const std::string &text);
+    void writeCharacters(const char *text, std::size_t len);
+
+    // Write an element only containing the given text.
+    void writeTextElement(const char *name, const std::string &text);
+
+    // Close the current element.
+    void writeEndElement();
+
+    // Return the number of open elements.
+    std::size_t depth() const {return elems.size();}
+
+    // Format a number into buf (at least 32 chars) and return its length.
+    // Doubles use 12 significant digits, which is well beyond what SiQAD
+    // reads back (single precision) while formatting noticeably faster than
+    // full round-trip precision.
+    static int formatNumber(char *buf, double value)
+    {
+      return std::snprintf(buf, 32, "%.12g", value);
+    }
+    static int formatNumber(char *buf, float value)
+    {
+      return std::snprintf(buf, 32, "%.*g", std::numeric_limits<float>::max_digits10, value);
+    }
+
+  private:
+
+    // Finish the start tag of the current element if it is still open.
+    void closeStartTag();
+
+    // Write a newline followed by the indentation of the given depth.
+    void writeIndent(std::size_t level);
+
+    // Write text with XML special characters escaped.
+    void writeEscaped(const char *text, std::size_t len, bool in_attribute);
+
+    // Write an attribute whose value is already free of special characters.
+    void writeRawAttribute(const char *name, const char *value, int len);
+
+    std::ostream &os;
+    int indent;
+    std::vector<std::string> elems;   // names of open elements
+    bool start_tag_open=false;        // current start tag awaits '>'
+    bool has_child_elems=false;       // current element contains elements
+    bool has_text=false;              // current element contains text
+  };
+
+  // Result file which results are written to, kept open between appends
+  // when streaming results. A flusher thread flushes appended results once
+  // flush_interval seconds have passed since the last flush, so they reach
+  // the disk even if the plugin appends nothing more for a while. Writes
+  // and flushes are serialized by the connector's result_stream_mutex.
+  struct ResultStream
+  {
+    ResultStream(const std::string &path, std::mutex &mutex, double flush_interval)
+      : buf(1<<16), ws(file), last_flush(std::chrono::steady_clock::now()),
+        mutex(mutex), flush_interval(flush_interval)
+    {
+      file.rdbuf()->pubsetbuf(buf.data(), buf.size());
+      file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+      flusher = std::thread(&ResultStream::flushLoop, this);
+    }
+
+    ~ResultStream() {stopFlusher();}
+
+    // Flush the file, the caller must hold mutex.
+    void flush()
+    {
+      file.flush();
+      last_flush = std::chrono::steady_clock::now();
+      pending = false;
+    }
+
+    // Note that results were appended, the caller must hold mutex.
+    void appended()
+    {
+      if (!pending) {
+        pending = true;
+        flush_cv.notify_one();
+      }
+    }
+
+    // Stop the flusher thread, after which the stream is only written by the
+    // calling thread. The caller must not hold mutex.
+    void stopFlusher()
+    {
+      if (!flusher.joinable())
+        return;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      flush_cv.notify_one();
+      flusher.join();
+    }
+
+    std::vector<char> buf;            // output buffer of file
+    std::ofstream file;
+    XMLStreamWriter ws;
+    std::string section;              // open streamed section, if any
+    std::string dist_buf;             // reused charge string buffer
+    std::chrono::steady_clock::time_point last_flush;
+
+  private:
+
+    void flushLoop()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        flush_cv.wait(lock, [this]() {return stop || pending;});
+        if (stop)
+          return;
+        auto due = last_flush + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(flush_interval));
+        if (flush_cv.wait_until(lock, due, [this]() {return stop;}))
+          return;
+        if (pending)
+          flush();
+      }
+    }
+
+    std::mutex &mutex;
+    double flush_interval;
+    std::condition_variable flush_cv;
+    std::thread flusher;
+    bool pending=false;               // appended results await a flush
+    bool stop=false;                  // flusher thread should exit
+  };
+
+}
+
+void XMLStreamWriter::writeEndDocument()
+{
+  while (!elems.empty())
+    writeEndElement();
+  os << '\n';
+}
+
+void XMLStreamWriter::writeStartElement(const char *name)
+{
+  closeStartTag();
+  writeIndent(elems.size());
+  os << '<' << name;
+  elems.push_back(name);
+  start_tag_open = true;
+  has_child_elems = false;
+  has_text = false;
+}
+
+void XMLStreamWriter::writeAttribute(const char *name, const std::string &value)
+{
+  os << ' ' << name << "=\"";
+  writeEscaped(value.data(), value.size(), true);
+  os << '"';
+}
+
+void XMLStreamWriter::writeAttribute(const char *name, double value)
+{
+  char buf[32];
+  writeRawAttribute(name, buf, formatNumber(buf, value));
+}
+
+void XMLStreamWriter::writeAttribute(const char *name, float value)
+{
+  char buf[32];
+  writeRawAttribute(name, buf, formatNumber(buf, value));
+}
+
+void XMLStreamWriter::writeAttribute(const char *name, int value)
+{
+  char buf[16];
+  writeRawAttribute(name, buf, std::snprintf(buf, sizeof(buf), "%d", value));
+}
+
+void XMLStreamWriter::writeCharacters(const std::string &text)
+{
+  writeCharacters(text.data(), text.size());
+}
+
+void XMLStreamWriter::writeCharacters(const char *text, std::size_t len)
+{
+  closeStartTag();
+  writeEscaped(text, len, false);
+  has_text = true;
+}
+
+void XMLStreamWriter::writeTextElement(const char *name, const std::string &text)
+{
+  writeStartElement(name);
+  writeCharacters(text);
+  writeEndElement();
+}
+
+void XMLStreamWriter::writeEndElement()
+{
+  if (start_tag_open) {
+    os << "/>";
+    start_tag_open = false;
+  } else {
+    if (has_child_elems && !has_text)
+      writeIndent(elems.size()-1);
+    os << "</" << elems.back() << '>';
+  }
+  elems.pop_back();
+  // the parent now contains at least one element
+  has_child_elems = true;
+  has_text = false;
+}
+
+void XMLStreamWriter::closeStartTag()
+{
+  if (start_tag_open) {
+    os << '>';
+    start_tag_open = false;
+  }
+}
+
+void XMLStreamWriter::writeIndent(std::size_t level)
+{
+  os << '\n';
+  for (std::size_t i=0; i<level*indent; i++)
+    os << ' ';
+}
+
+void XMLStreamWriter::writeEscaped(const char *text, std::size_t len, bool in_attribute)
+{
+  std::size_t run_start = 0;
+  for (std::size_t i=0; i<len; i++) {
+    const char *esc = nullptr;
+    switch (text[i]) {
+      case '<': esc = "&lt;"; break;
+      case '>': esc = "&gt;"; break;
+      case '&': esc = "&amp;"; break;
+      case '"': esc = in_attribute ? "&quot;" : nullptr; break;
+      default: break;
+    }
+    if (esc) {
+      os.write(text+run_start, i-run_start);
+      os << esc;
+      run_start = i+1;
+    }
+  }
+  os.write(text+run_start, len-run_start);
+}
+
+void XMLStreamWriter::writeRawAttribute(const char *name, const char *value, int len)
+{
+  os << ' ' << name << "=\"";
+  os.write(value, len);
+  os << '"';
+}
+
+
+// RESULT WRITING
+
+// Write a dist element for the given charge configuration, a physically_valid
+// of -1 omits the attribute. dist is used as scratch space.
+static void writeChargeDist(XMLStreamWriter &ws, const int8_t *config,
+    std::size_t n_dbs, double energy, int count, int physically_valid,
+    std::string &dist)
+{
+  dist.resize(n_dbs);
+  for (std::size_t j = 0; j < n_dbs; j++)
+    dist[j] = config[j] < 0 ? '-' : (config[j] > 0 ? '+' : '0');
+  ws.writeStartElement("dist");
+  ws.writeAttribute("energy", energy);
+  ws.writeAttribute("count", count);
+  if (physically_valid != -1)
+    ws.writeAttribute("physically_valid", physically_valid);
+  ws.writeAttribute("state_count", 3);
+  ws.writeCharacters(dist);
+  ws.writeEndElement();
+}
+
+// Write a number attribute of a typed export. Values exported from floats are
+// written at float precision so that they read back as the same floats
+// without the noise digits of their double widening.
+static void writeNumberAttribute(XMLStreamWriter &ws, const char *name,
+    double value, bool single_precision)
+{
+  if (single_precision)
+    ws.writeAttribute(name, static_cast<float>(value));
+  else
+    ws.writeAttribute(name, value);
+}
+
+// Write an element only containing a number of a typed export.
+static void writeNumberElement(XMLStreamWriter &ws, const char *name,
+    double value, bool single_precision)
+{
+  char buf[32];
+  int len = single_precision ? XMLStreamWriter::formatNumber(buf, static_cast<float>(value))
+      : XMLStreamWriter::formatNumber(buf, value);
+  ws.writeStartElement(name);
+  ws.writeCharacters(buf, len);
+  ws.writeEndElement();
+}
+
+// Write a potential_val element from a row of (x, y, potential).
+static void writePotentialVal(XMLStreamWriter &ws, const double *row,
+    bool single_precision=false)
+{
+  ws.writeStartElement("potential_val");
+  writeNumberAttribute(ws, "x", row[0], single_precision);
+  writeNumberAttribute(ws, "y", row[1], single_precision);
+  writeNumberAttribute(ws, "val", row[2], single_precision);
+  ws.writeEndElement();
+}
+
+// Write a dbdot element from a row of (step, x, y, potential).
+static void writeDBPotentialDot(XMLStreamWriter &ws, const double *row,
+    bool single_precision=false)
+{
+  ws.writeStartElement("dbdot");
+  writeNumberElement(ws, "step", row[0], single_precision);
+  ws.writeStartElement("physloc");
+  writeNumberAttribute(ws, "x", row[1], single_precision);
+  writeNumberAttribute(ws, "y", row[2], single_precision);
+  ws.writeEndElement();
+  writeNumberElement(ws, "potential", row[3], single_precision);
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writeResultsXml()
+{
+  log(LogDebug) << "SiQADConnector::writeResultsXml()" << '\n';
+
+  if (results_finalized) {
+    log(LogDebug) << "Results have already been written." << '\n';
+    return;
+  }
+
+  log(LogInfo) << "Write results to XML..." << '\n';
+
+  startPhase("export");
+  mergeResultBuffers();
+
+  if (!result_stream && !openResultStream()) {
+    endPhase("export");
+    return;
+  }
+  // the rest of the results is written and closed by this thread alone
+  result_stream->stopFlusher();
+  endStreamedSection();
+  XMLStreamWriter &ws = result_stream->ws;
+
+  // DB locations
+  if (!dbl_data.empty() || typed_exports.count("db_loc"))
+    writeDBLocations(ws);
+
+  // DB electron distributions
+  if (!db_charge_data.empty() || !charge_export.energies.empty()
+      || !charge_configs.empty())
+    writeDBCharges(ws);
+
+  // electrode
+  if (!elec_data.empty() || typed_exports.count("electrodes"))
+    writeElectrodes(ws);
+
+  //electric potentials
+  if (!pot_data.empty() || typed_exports.count("potential"))
+    writePotentials(ws);
+
+  //potentials at db locations
+  if (!db_pot_data.empty() || typed_exports.count("db_pot"))
+    writeDBPotentials(ws);
+
+  // SQCommands
+  if (!export_commands.empty()) {
+    log(LogDebug) << "export commands not empty, starting to fill them in." << '\n';
+    writeSQCommands(ws);
+  }
+
+  // eng_info is written last as it holds the timing information
+  endPhase("export");
+  writeEngInfo(ws);
+
+  // close root node
+  ws.writeEndDocument();
+  result_stream->file.close();
+  result_stream.reset();
+  results_finalized = true;
+
+  log(LogInfo) << "Write to XML complete." << std::endl;
+}
+
+bool SiQADConnector::openResultStream()
+{
+  std::unique_ptr<ResultStream> rs(new ResultStream(output_path,
+      result_stream_mutex, stream_flush_interval));
+  if (!rs->file) {
+    std::cerr << "Unable to open result file " << output_path << std::endl;
+    return false;
+  }
+
+  rs->ws.writeStartDocument();
+  rs->ws.writeStartElement("sim_out");
+
+  // sim_params
+  writeSimParams(rs->ws);
+
+  result_stream = std::move(rs);
+  return true;
+}
+
+XMLStreamWriter &SiQADConnector::streamedSection(const char *name)
+{
+  if (results_finalized)
+    throw std::runtime_error(std::string("Results have already been written to ")
+        + output_path);
+  if (!result_stream && !openResultStream())
+    throw std::runtime_error(std::string("Unable to open result file ") + output_path);
+
+  if (result_stream->section != name) {
+    endStreamedSection();
+    result_stream->ws.writeStartElement(name);
+    result_stream->section = name;
+  }
+  return result_stream->ws;
+}
+
+void SiQADConnector::endStreamedSection()
+{
+  if (result_stream && !result_stream->section.empty()) {
+    result_stream->ws.writeEndElement();
+    result_stream->section.clear();
+  }
+}
+
+void SiQADConnector::flushResults()
+{
+  std::lock_guard<std::mutex> lock(result_stream_mutex);
+  if (result_stream)
+    result_stream->flush();
+}
+
+void SiQADConnector::resultsAppended()
+{
+  std::chrono::duration<double> since_flush = std::chrono::steady_clock::now()
+    - result_stream->last_flush;
+  if (since_flush.count() >= stream_flush_interval)
+    result_stream->flush();
+  else
+    result_stream->appended();
+}
+
+void SiQADConnector::appendDBCharge(const int8_t *charges, std::size_t n_dbs,
+    double energy, int count, int physically_valid)
+{
+  std::lock_guard<std::mutex> lock(result_stream_mutex);
+  XMLStreamWriter &ws = streamedSection("elec_dist");
+  writeChargeDist(ws, charges, n_dbs, energy, count, physically_valid,
+      result_stream->dist_buf);
+  resultsAppended();
+}
+
+void SiQADConnector::appendDBCharge(const std::string &dist,
+    const std::string &energy, const std::string &count)
+{
+  std::lock_guard<std::mutex> lock(result_stream_mutex);
+  XMLStreamWriter &ws = streamedSection("elec_dist");
+  ws.writeStartElement("dist");
+  ws.writeAttribute("energy", energy);
+  ws.writeAttribute("count", count);
+  ws.writeCharacters(dist);
+  ws.writeEndElement();
+  resultsAppended();
+}
+
+void SiQADConnector::appendPotentials(const double *data_in, std::size_t rows)
+{
+  std::lock_guard<std::mutex> lock(result_stream_mutex);
+  XMLStreamWriter &ws = streamedSection("potential_map");
+  for (std::size_t i = 0; i < rows; i++)
+    writePotentialVal(ws, data_in + 3*i);
+  resultsAppended();
+}
+
+void SiQADConnector::appendDBPotentials(const double *data_in, std::size_t rows)
+{
+  std::lock_guard<std::mutex> lock(result_stream_mutex);
+  XMLStreamWriter &ws = streamedSection("dbdots");
+  for (std::size_t i = 0; i < rows; i++)
+    writeDBPotentialDot(ws, data_in + 4*i);
+  resultsAppended();
+}
+
+void SiQADConnector::writeEngInfo(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("eng_info");
+  ws.writeTextElement("engine", eng_name);
+  ws.writeTextElement("version", "TBD"); // TODO real version
+  ws.writeTextElement("return_code", std::to_string(return_code));
+
+  //get timing information
+  end_time = std::chrono::system_clock::now();
+  std::chrono::duration<double> elapsed_seconds = end_time-start_time;
+  std::time_t end = std::chrono::system_clock::to_time_t(end_time);
+  char* end_c_str = std::ctime(&end);
+  *std::remove(end_c_str, end_c_str+strlen(end_c_str), '\n') = '\0'; // removes _all_ new lines from the cstr
+  ws.writeTextElement("timestamp", end_c_str);
+  ws.writeTextElement("time_elapsed_s", std::to_string(elapsed_seconds.count()));
+
+  // resource usage of the process
+#ifndef _WIN32
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    auto seconds = [](const timeval &tv) {return tv.tv_sec + tv.tv_usec * 1e-6;};
+    ws.writeTextElement("cpu_user_s", std::to_string(seconds(usage.ru_utime)));
+    ws.writeTextElement("cpu_system_s", std::to_string(seconds(usage.ru_stime)));
+#ifdef __APPLE__
+    long peak_rss_kb = usage.ru_maxrss / 1024;  // reported in bytes
+#else
+    long peak_rss_kb = usage.ru_maxrss;         // reported in kilobytes
+#endif
+    ws.writeTextElement("peak_rss_kb", std::to_string(peak_rss_kb));
+  }
+#endif
+
+  // time spent in each phase
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  if (!phases.empty()) {
+    const auto now = std::chrono::steady_clock::now();
+    ws.writeStartElement("phases");
+    for (const Phase &phase : phases) {
+      std::chrono::duration<double> open_time = now - phase.start;
+      ws.writeStartElement("phase");
+      ws.writeAttribute("name", phase.name);
+      ws.writeCharacters(std::to_string(phase.elapsed
+            + (phase.depth > 0 ? open_time.count() : 0.)));
+      ws.writeEndElement();
+    }
+    ws.writeEndElement();
+  }
+  ws.writeEndElement();
+}
+
+void SiQADConnector::startPhase(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  auto phase = std::find_if(phases.begin(), phases.end(),
+      [&name](const Phase &p) {return p.name == name;});
+  if (phase == phases.end()) {
+    phases.push_back(Phase());
+    phase = phases.end() - 1;
+    phase->name = name;
+  }
+  if (phase->depth++ == 0)
+    phase->start = std::chrono::steady_clock::now();
+}
+
+void SiQADConnector::endPhase(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  auto phase = std::find_if(phases.begin(), phases.end(),
+      [&name](const Phase &p) {return p.name == name;});
+  if (phase == phases.end() || phase->depth == 0) {
+    log(LogInfo) << "Phase " << name << " ended without being started." << '\n';
+    return;
+  }
+  if (--phase->depth == 0) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - phase->start;
+    phase->elapsed += elapsed.count();
+  }
+}
+
+double SiQADConnector::phaseTime(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  for (const Phase &phase : phases) {
+    if (phase.name == name) {
+      std::chrono::duration<double> open_time = std::chrono::steady_clock::now() - phase.start;
+      return phase.elapsed + (phase.depth > 0 ? open_time.count() : 0.);
+    }
+  }
+  return 0;
+}
+
+void SiQADConnector::writeSimParams(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("sim_params");
+  for (std::pair<std::string, std::string> param : sim_params)
+    ws.writeTextElement(param.first.c_str(), param.second);
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writeDBLocations(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("physloc");
+  auto typed = typed_exports.find("db_loc");
+  if (typed != typed_exports.end()) {
+    const ExportTable &table = typed->second;
+    for (std::size_t i = 0; i < table.rows(); i++) {
+      ws.writeStartElement("dbdot");
+      writeNumberAttribute(ws, "x", table.at(i, 0), table.single_precision);
+      writeNumberAttribute(ws, "y", table.at(i, 1), table.single_precision);
+      ws.writeEndElement();
+    }
+  } else {
+    for (unsigned int i = 0; i < dbl_data.size(); i++){
+      ws.writeStartElement("dbdot");
+      ws.writeAttribute("x", dbl_data[i].first);
+      ws.writeAttribute("y", dbl_data[i].second);
+      ws.writeEndElement();
+    }
+  }
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writeDBCharges(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("elec_dist");
+  if (!charge_export.energies.empty()) {
+    const ChargeExport &ce = charge_export;
+    std::string dist;
+    for (std::size_t i = 0; i < ce.energies.size(); i++) {
+      writeChargeDist(ws, ce.charges.data() + i*ce.n_dbs, ce.n_dbs,
+          ce.energies[i], ce.counts.empty() ? 1 : ce.counts[i],
+          ce.physically_valid.empty() ? -1 : ce.physically_valid[i], dist);
+    }
+  } else {
+    for (unsigned int i = 0; i < db_charge_data.size(); i++){
+      ws.writeStartElement("dist");
+      ws.writeAttribute("energy", db_charge_data[i][1]);
+      ws.writeAttribute("count", db_charge_data[i][2]);
+      if (db_charge_data[i].size() > 3 && db_charge_data[i][3] != "-1")
+        ws.writeAttribute("physically_valid", db_charge_data[i][3]);
+      if (db_charge_data[i].size() > 4)
+        ws.writeAttribute("state_count", db_charge_data[i][4]);
+      ws.writeCharacters(db_charge_data[i][0]);
+      ws.writeEndElement();
+    }
+  }
+  if (!charge_configs.empty()) {
+    std::vector<int8_t> config(charge_configs.dbCount());
+    std::string dist;
+    for (const auto &cc : charge_configs.sorted()) {
+      charge_configs.unpack(*cc.first, config.data());
+      writeChargeDist(ws, config.data(), config.size(), cc.second->energy,
+          cc.second->count, cc.second->physically_valid, dist);
+    }
+  }
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writeElectrodes(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("electrode");
+  auto typed = typed_exports.find("electrodes");
+  if (typed != typed_exports.end()) {
+    const ExportTable &table = typed->second;
+    for (std::size_t i = 0; i < table.rows(); i++) {
+      ws.writeStartElement("dim");
+      writeNumberAttribute(ws, "x1", table.at(i, 0), table.single_precision);
+      writeNumberAttribute(ws, "y1", table.at(i, 1), table.single_precision);
+      writeNumberAttribute(ws, "x2", table.at(i, 2), table.single_precision);
+      writeNumberAttribute(ws, "y2", table.at(i, 3), table.single_precision);
+      ws.writeEndElement();
+      writeNumberElement(ws, "potential", table.at(i, 4), table.single_precision);
+    }
+  } else {
+    for (unsigned int i = 0; i < elec_data.size(); i++){
+      ws.writeStartElement("dim");
+      ws.writeAttribute("x1", elec_data[i][0]);
+      ws.writeAttribute("y1", elec_data[i][1]);
+      ws.writeAttribute("x2", elec_data[i][2]);
+      ws.writeAttribute("y2", elec_data[i][3]);
+      ws.writeEndElement();
+      ws.writeTextElement("potential", elec_data[i][4]);
+    }
+  }
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writePotentials(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("potential_map");
+  auto typed = typed_exports.find("potential");
+  if (typed != typed_exports.end()) {
+    const ExportTable &table = typed->second;
+    for (std::size_t i = 0; i < table.rows(); i++)
+      writePotentialVal(ws, &table.values[i*table.cols], table.single_precision);
+  } else {
+    for (unsigned int i = 0; i < pot_data.size(); i++){
+      ws.writeStartElement("potential_val");
+      ws.writeAttribute("x", pot_data[i][0]);
+      ws.writeAttribute("y", pot_data[i][1]);
+      ws.writeAttribute("val", pot_data[i][2]);
+      ws.writeEndElement();
+    }
+  }
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writeDBPotentials(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("dbdots");
+  auto typed = typed_exports.find("db_pot");
+  if (typed != typed_exports.end()) {
+    const ExportTable &table = typed->second;
+    for (std::size_t i = 0; i < table.rows(); i++)
+      writeDBPotentialDot(ws, &table.values[i*table.cols], table.single_precision);
+  } else {
+    for (unsigned int i = 0; i < db_pot_data.size(); i++){
+      ws.writeStartElement("dbdot");
+      ws.writeTextElement("step", db_pot_data[i][0]);
+      ws.writeStartElement("physloc");
+      ws.writeAttribute("x", db_pot_data[i][1]);
+      ws.writeAttribute("y", db_pot_data[i][2]);
+      ws.writeEndElement();
+      ws.writeTextElement("potential", db_pot_data[i][3]);
+      ws.writeEndElement();
+    }
+  }
+  ws.writeEndElement();
+}
+
+void SiQADConnector::writeSQCommands(XMLStreamWriter &ws)
+{
+  ws.writeStartElement("sqcommands");
+  for (unsigned int i = 0; i < export_commands.size(); i++) {
+    if (logEnabled(LogDebug))
+      log(LogDebug) << "command " << i << ": " << export_commands.at(i) << '\n';
+    ws.writeTextElement("sqc", export_commands.at(i));
+  }
+  ws.writeEndElement();
+}
+
+
+// SCREENED COULOMB
+
+ScreenedCoulomb::ScreenedCoulomb(double eps_r, double debye_length)
+{
+  const double q0 = 1.602176634e-19;    // elementary charge (C)
+  const double eps0 = 8.8541878128e-12; // vacuum permittivity (F/m)
+  const double pi = 3.14159265358979323846;
+
+  // V [eV] = q0 / (4 pi eps0 eps_r r) * exp(-r / debye_length), r in m
+  k_c = q0 / (4 * pi * eps0 * eps_r) * 1e10;
+  inv_debye = debye_length > 0 ? 0.1 / debye_length : 0;
+}
+
+
+// LATTICE INTERACTION KERNEL
+
+LatticeInteractionKernel::LatticeInteractionKernel(const Lattice &lattice,
+    const ScreenedCoulomb &interaction, double cutoff)
+  : r_cut(cutoff), n_cell(static_cast<int>(lattice.b.size()))
+{
+  const std::pair<double, double> &a1 = lattice.a1;
+  const std::pair<double, double> &a2 = lattice.a2;
+  const double area = std::fabs(a1.first*a2.second - a1.second*a2.first);
+  if (area == 0 || n_cell == 0)
+    throw std::invalid_argument("Degenerate lattice vectors");
+
+  // largest separation between sites of the same unit cell
+  double b_span = 0;
+  for (const std::pair<double, double> &b_i : lattice.b)
+    for (const std::pair<double, double> &b_j : lattice.b)
+      b_span = std::max(b_span, std::hypot(b_j.first-b_i.first, b_j.second-b_i.second));
+
+  // offsets along a1 (a2) beyond the cutoff plus the cell span cannot be
+  // within reach, the lattice line spacing is area / |a2| (area / |a1|)
+  const double reach = cutoff + b_span;
+  dn_max = static_cast<int>(std::ceil(reach * std::hypot(a2.first, a2.second) / area));
+  dm_max = static_cast<int>(std::ceil(reach * std::hypot(a1.first, a1.second) / area));
+
+  table.assign(static_cast<std::size_t>(2*dn_max+1) * (2*dm_max+1) * n_cell * n_cell, 0);
+  std::size_t ind = 0;
+  for (int dn=-dn_max; dn<=dn_max; dn++) {
+    for (int dm=-dm_max; dm<=dm_max; dm++) {
+      for (int l_i=0; l_i<n_cell; l_i++) {
+        for (int l_j=0; l_j<n_cell; l_j++, ind++) {
+          double dx = dn*a1.first + dm*a2.first + lattice.b[l_j].first - lattice.b[l_i].first;
+          double dy = dn*a1.second + dm*a2.second + lattice.b[l_j].second - lattice.b[l_i].second;
+          double r = std::hypot(dx, dy);
+          if (r > 0 && r <= cutoff)
+            table[ind] = interaction(r);
+        }
+      }
+    }
+  }
+}
+
+
+// CHARGE CONFIG ACCUMULATOR
+
+void ChargeConfigAccumulator::setLimit(std::size_t t_max_configs)
+{
+  max_configs = t_max_configs;
+  heap = std::priority_queue<HeapItem>();
+  if (max_configs == 0)
+    return;
+  for (const auto &config : configs)
+    heap.push(HeapItem(config.second.energy, &config.first));
+  evict();
+}
+
+void ChargeConfigAccumulator::add(const int8_t *charges, std::size_t t_n_dbs,
+    double energy, int physically_valid)
+{
+  checkDBCount(t_n_dbs);
+
+  // pack 4 DBs per byte, storing charge+1 in 2 bits each
+  key.assign((n_dbs+3)/4, '\0');
+  for (std::size_t i = 0; i < n_dbs; i++)
+    key[i/4] |= static_cast<char>((charges[i]+1) << (2*(i%4)));
+
+  insert(key, energy, 1, physically_valid);
+}
+
+void ChargeConfigAccumulator::merge(const ChargeConfigAccumulator &other)
+{
+  if (other.empty())
+    return;
+  checkDBCount(other.n_dbs);
+  for (const auto &config : other.configs)
+    insert(config.first, config.second.energy, config.second.count,
+        config.second.physically_valid);
+}
+
+void ChargeConfigAccumulator::checkDBCount(std::size_t t_n_dbs)
+{
+  if (configs.empty())
+    n_dbs = t_n_dbs;
+  else if (t_n_dbs != n_dbs)
+    throw std::invalid_argument("Charge configuration has " + std::to_string(t_n_dbs)
+        + " DBs, expected " + std::to_string(n_dbs));
+}
+
+void ChargeConfigAccumulator::insert(const std::string &packed, double energy,
+    int count, int physically_valid)
+{
+  auto found = configs.find(packed);
+  if (found != configs.end()) {
+    found->second.count += count;
+    return;
+  }
+
+  // a full set only admits configurations of lower energy than its highest
+  if (max_configs > 0 && configs.size() >= max_configs && energy >= heap.top().first)
+    return;
+
+  Entry entry = {energy, count, physically_valid};
+  auto inserted = configs.insert(std::make_pair(packed, entry)).first;
+  if (max_configs > 0) {
+    heap.push(HeapItem(energy, &inserted->first));
+    evict();
+  }
+}
+
+void ChargeConfigAccumulator::clear()
+{
+  configs.clear();
+  heap = std::priority_queue<HeapItem>();
+  n_dbs = 0;
+}
+
+std::vector<std::pair<const std::string*, const ChargeConfigAccumulator::Entry*>>
+  ChargeConfigAccumulator::sorted() const
+{
+  std::vector<std::pair<const std::string*, const Entry*>> sorted_configs;
+  sorted_configs.reserve(configs.size());
+  for (const auto &config : configs)
+    sorted_configs.push_back(std::make_pair(&config.first, &config.second));
+  std::sort(sorted_configs.begin(), sorted_configs.end(),
+      [](const std::pair<const std::string*, const Entry*> &a,
+         const std::pair<const std::string*, const Entry*> &b)
+      {
+        return a.second->energy < b.second->energy;
+      });
+  return sorted_configs;
+}
+
+void ChargeConfigAccumulator::unpack(const std::string &packed, int8_t *charges) const
+{
+  for (std::size_t i = 0; i < n_dbs; i++)
+    charges[i] = static_cast<int8_t>(((packed[i/4] >> (2*(i%4))) & 3) - 1);
+}
+
+void ChargeConfigAccumulator::evict()
+{
+  while (configs.size() > max_configs) {
+    auto highest = configs.find(*heap.top().second);
+    heap.pop();
+    configs.erase(highest);
+  }
+}
+
+
+// DB SPATIAL INDEX
+
+DBSpatialIndex::DBSpatialIndex(const DBStore &t_store, double t_cell_size)
+  : store(&t_store), cell_size(t_cell_size)
+{
+  const std::size_t n_dbs = store->size();
+  std::vector<uint64_t> keys(n_dbs);
+  sorted_dbs.resize(n_dbs);
+  for (std::size_t i=0; i<n_dbs; i++) {
+    keys[i] = cellKey(cellCoord(store->x[i]), cellCoord(store->y[i]));
+    sorted_dbs[i] = static_cast<int>(i);
+  }
+  std::sort(sorted_dbs.begin(), sorted_dbs.end(),
+      [&keys](int a, int b) {return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);});
+
+  // record the range of each occupied cell
+  cells.reserve(n_dbs);
+  std::size_t begin = 0;
+  for (std::size_t k=1; k<=n_dbs; k++) {
+    if (k == n_dbs || keys[sorted_dbs[k]] != keys[sorted_dbs[begin]]) {
+      cells[keys[sorted_dbs[begin]]] = std::make_pair(static_cast<int>(begin), static_cast<int>(k));
+      begin = k;
+    }
+  }
+}
+
+void DBSpatialIndex::neighborsWithin(std::size_t i, double r, std::vector<int> &out) const
+{
+  const float xi = store->x[i], yi = store->y[i];
+  const double r_sq = r*r;
+  const int64_t cx_min = cellCoord(xi - r), cx_max = cellCoord(xi + r);
+  const int64_t cy_min = cellCoord(yi - r), cy_max = cellCoord(yi + r);
+  for (int64_t cx=cx_min; cx<=cx_max; cx++) {
+    for (int64_t cy=cy_min; cy<=cy_max; cy++) {
+      auto cell = cells.find(cellKey(cx, cy));
+      if (cell == cells.end())
+        continue;
+      for (int k=cell->second.first; k<cell->second.second; k++) {
+        const int j = sorted_dbs[k];
+        const double dx = store->x[j] - xi, dy = store->y[j] - yi;
+        if (dx*dx + dy*dy <= r_sq && j != static_cast<int>(i))
+          out.push_back(j);
+      }
+    }
+  }
+}
+
+
+// DB STORE
+
+void DBStore::build(const std::shared_ptr<Aggregate> &root)
+{
+  x.clear();
+  y.clear();
+  n.clear();
+  m.clear();
+  l.clear();
+  dbs.clear();
+  append(root);
+}
+
+void DBStore::append(const std::shared_ptr<Aggregate> &agg)
+{
+  agg->db_begin = dbs.size();
+  for (const std::shared_ptr<DBDot> &db : agg->dbs) {
+    x.push_back(db->x);
+    y.push_back(db->y);
+    n.push_back(db->n);
+    m.push_back(db->m);
+    l.push_back(db->l);
+    dbs.push_back(db);
+  }
+  for (const std::shared_ptr<Aggregate> &child : agg->aggs)
+    append(child);
+  agg->db_end = dbs.size();
+}
+
+//DB ITERATOR
+
+DBIterator::DBIterator(const DBStore *store, bool begin)
+  : collection(nullptr), store(store), ind(begin ? 0 : store->size())
+{}
+
+std::shared_ptr<DBDot> DBIterator::operator*() const
+{
+  return store->dbs[ind];
 }
 
 
@@ -18,6 +18,17 @@
 #include <memory>
 #include <map>
 #include <iostream>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <queue>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -32,7 +43,14 @@ namespace phys{
 
   // forward declaration
   struct Layer;
+  struct Lattice;
+  struct ScreenedCoulomb;
+  class LatticeInteractionKernel;
+  class ChargeConfigAccumulator;
+  class ResultBuffer;
   struct DBDot;
+  struct DBStore;
+  class DBSpatialIndex;
   class DBIterator;
   class DBCollection;
   struct Electrode;
@@ -43,6 +61,10 @@ namespace phys{
   class ElectrodePolyCollection;
   struct Aggregate;
 
+  class XMLStreamReader;
+  class XMLStreamWriter;
+  struct ResultStream;
+
   class SQCommand;
   class AggregateCommand;
 
@@ -51,6 +73,311 @@ namespace phys{
   typedef std::vector<std::shared_ptr<ElectrodePoly>>::const_iterator ElecPolyIter;
   typedef std::vector<std::shared_ptr<Aggregate>>::const_iterator AggIter;
 
+  // lattice geometry, the physical location of site (n, m, l) in angstroms is
+  // n*a1 + m*a2 + b[l]
+  struct Lattice {
+    Lattice()
+      : a1(3.84, 0), a2(0, 7.68), b({{0, 0}, {0, 2.25}}) {};
+    std::pair<double, double> a1, a2;           // lattice vectors
+    std::vector<std::pair<double, double>> b;   // site offsets within the unit cell
+
+    // Return the physical location of the given lattice site.
+    std::pair<double, double> siteLocation(int n, int m, int l) const
+    {
+      return std::make_pair(n*a1.first + m*a2.first + b.at(l).first,
+                            n*a1.second + m*a2.second + b.at(l).second);
+    }
+  };
+
+  // screened Coulomb interaction energy between two singly charged DBs
+  struct ScreenedCoulomb {
+    // Relative permittivity and Debye length in nm, a non-positive Debye
+    // length disables screening.
+    ScreenedCoulomb(double eps_r, double debye_length);
+
+    // Return the interaction energy in eV at separation r in angstroms.
+    double operator()(double r) const {return k_c * std::exp(-r * inv_debye) / r;}
+
+    double k_c;         // q0 / (4 pi eps0 eps_r) in eV angstroms
+    double inv_debye;   // inverse Debye length in 1/angstroms
+  };
+
+  // Interaction kernel of a periodic lattice. The interaction between two
+  // sites only depends on their separation, i.e. on (dn, dm, l_i, l_j), so it
+  // is tabulated once for all offsets within a cutoff radius. Memory scales
+  // as O(R^2) for cutoff R instead of O(N^2) for N DBs.
+  class LatticeInteractionKernel
+  {
+  public:
+    // Tabulate the interaction for all offsets with site separation up to
+    // cutoff angstroms.
+    LatticeInteractionKernel(const Lattice &lattice, const ScreenedCoulomb &interaction,
+        double cutoff);
+
+    // Return the interaction energy in eV between sites (n_i, m_i, l_i) and
+    // (n_j, m_j, l_j), which is zero for identical sites and beyond the cutoff.
+    double operator()(int n_i, int m_i, int l_i, int n_j, int m_j, int l_j) const
+    {
+      int dn = n_j - n_i;
+      int dm = m_j - m_i;
+      if (dn < -dn_max || dn > dn_max || dm < -dm_max || dm > dm_max)
+        return 0;
+      if (l_i < 0 || l_i >= n_cell || l_j < 0 || l_j >= n_cell)
+        throw std::out_of_range("Lattice site index out of range");
+      return table[(((dn+dn_max)*(2*dm_max+1) + dm+dm_max)*n_cell + l_i)*n_cell + l_j];
+    }
+
+    // Return the cutoff radius in angstroms.
+    double cutoff() const {return r_cut;}
+
+    // Return the number of tabulated entries.
+    std::size_t tableSize() const {return table.size();}
+
+  private:
+
+    double r_cut;             // cutoff radius
+    int dn_max, dm_max;       // largest tabulated offsets
+    int n_cell;               // sites per unit cell
+    std::vector<double> table;
+  };
+
+#ifndef SWIG
+  // Allocator handing out memory aligned to the given boundary (a cache line
+  // by default) so that loops over DBStore arrays can be vectorized cleanly.
+  template <typename T, std::size_t Alignment=64>
+  struct AlignedAllocator
+  {
+    typedef T value_type;
+    template <typename U> struct rebind {typedef AlignedAllocator<U, Alignment> other;};
+
+    AlignedAllocator() {};
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {};
+
+    T *allocate(std::size_t count)
+    {
+      if (count == 0)
+        return nullptr;
+      void *ptr = nullptr;
+#ifdef _WIN32
+      ptr = _aligned_malloc(count*sizeof(T), Alignment);
+#else
+      if (posix_memalign(&ptr, Alignment, count*sizeof(T)) != 0)
+        ptr = nullptr;
+#endif
+      if (ptr == nullptr)
+        throw std::bad_alloc();
+      return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T *ptr, std::size_t)
+    {
+#ifdef _WIN32
+      _aligned_free(ptr);
+#else
+      free(ptr);
+#endif
+    }
+  };
+
+  template <typename T, typename U, std::size_t A>
+  bool operator==(const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) {return true;}
+  template <typename T, typename U, std::size_t A>
+  bool operator!=(const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) {return false;}
+
+  template <typename T>
+  using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+  // Contiguous structure-of-arrays store of all DBs in the problem, built once
+  // after the problem file has been read. DBs are stored in DBIterator order
+  // (an aggregate's own DBs followed by those of its child aggregates), so the
+  // DBs of every aggregate occupy the contiguous index range
+  // [Aggregate::db_begin, Aggregate::db_end). Array element i describes the
+  // same DB as dbs[i].
+  struct DBStore
+  {
+    AlignedVector<float> x, y;                // physical locations in angstroms
+    AlignedVector<int> n, m, l;               // lattice coordinates
+    std::vector<std::shared_ptr<DBDot>> dbs;  // DBDot objects in store order
+
+    // Return the number of DBs.
+    std::size_t size() const {return dbs.size();}
+
+    // Rebuild the store from the given item tree and update the DB index
+    // ranges of all aggregates in it.
+    void build(const std::shared_ptr<Aggregate> &root);
+
+  private:
+
+    // Append the DBs of the given aggregate and its children.
+    void append(const std::shared_ptr<Aggregate> &agg);
+  };
+
+  // Uniform grid over the DB locations of a DBStore for fixed-radius neighbor
+  // queries. DBs are sorted by grid cell and only occupied cells are kept, so
+  // memory stays linear in the DB count however sparse the layout is. Queries
+  // are fastest for radii close to the cell size.
+  class DBSpatialIndex
+  {
+  public:
+    // Build the index with the given cell size in angstroms.
+    DBSpatialIndex(const DBStore &store, double cell_size);
+
+    // Return the cell size in angstroms.
+    double cellSize() const {return cell_size;}
+
+    // Append the indices of all DBs other than i within distance r (in
+    // angstroms) of DB i to out.
+    void neighborsWithin(std::size_t i, double r, std::vector<int> &out) const;
+
+  private:
+
+    // Return the key of the grid cell (cx, cy).
+    static uint64_t cellKey(int64_t cx, int64_t cy)
+    {
+      return (static_cast<uint64_t>(cx) << 32) ^ (static_cast<uint64_t>(cy) & 0xffffffffu);
+    }
+
+    // Return the grid cell coordinate of a physical coordinate.
+    int64_t cellCoord(double v) const
+    {
+      return static_cast<int64_t>(std::floor(v / cell_size));
+    }
+
+    const DBStore *store;
+    double cell_size;
+    std::vector<int> sorted_dbs;                              // DB indices sorted by cell
+    std::unordered_map<uint64_t, std::pair<int, int>> cells;  // cell key to range in sorted_dbs
+  };
+
+  // Symmetric N x N matrix with a zero diagonal, of which only the strict
+  // upper triangle (i < j) is stored, packed row by row. Row i holds the
+  // N-i-1 elements (i, i+1) ... (i, N-1) contiguously.
+  template <typename T>
+  class PackedSymmetricMatrix
+  {
+  public:
+    explicit PackedSymmetricMatrix(std::size_t dim=0)
+      : dim(dim), elems(dim > 1 ? dim*(dim-1)/2 : 0) {};
+
+    // Return the matrix dimension N.
+    std::size_t size() const {return dim;}
+
+    // Return element (i, j), symmetric in i and j.
+    T operator()(std::size_t i, std::size_t j) const
+    {
+      if (i == j)
+        return T(0);
+      return i < j ? elems[rowOffset(i)+j-i-1] : elems[rowOffset(j)+i-j-1];
+    }
+
+    // Return a pointer to the stored part of row i, i.e. element (i, i+1).
+    T *row(std::size_t i) {return elems.data() + rowOffset(i);}
+    const T *row(std::size_t i) const {return elems.data() + rowOffset(i);}
+
+    // Return the packed storage.
+    const AlignedVector<T> &data() const {return elems;}
+
+  private:
+
+    std::size_t rowOffset(std::size_t i) const {return i*(2*dim-i-1)/2;}
+
+    std::size_t dim;
+    AlignedVector<T> elems;
+  };
+
+  // Accumulates charge configurations, merging identical ones into occurrence
+  // counts. Configurations are hashed in a packed form of 2 bits per DB. If a
+  // limit is set, only that many distinct configurations of lowest energy are
+  // kept in a bounded heap; the count of a configuration then only includes
+  // occurrences while it was kept.
+  class ChargeConfigAccumulator
+  {
+  public:
+    struct Entry {
+      double energy;
+      int count;
+      int physically_valid;
+    };
+
+    // Keep at most max_configs distinct configurations, 0 keeps all.
+    void setLimit(std::size_t max_configs);
+    std::size_t limit() const {return max_configs;}
+
+    // Add a configuration of DB charges in units of e (-1, 0 or +1), a
+    // physically_valid of -1 leaves the validity unspecified.
+    void add(const int8_t *charges, std::size_t n_dbs, double energy,
+        int physically_valid=-1);
+
+    // Merge the configurations of another accumulator, adding up counts.
+    void merge(const ChargeConfigAccumulator &other);
+
+    // Return the number of distinct configurations.
+    std::size_t size() const {return configs.size();}
+    bool empty() const {return configs.empty();}
+
+    // Return the number of DBs per configuration.
+    std::size_t dbCount() const {return n_dbs;}
+
+    // Remove all configurations.
+    void clear();
+
+    // Return the distinct configurations as (packed state, entry) pairs in
+    // ascending order of energy.
+    std::vector<std::pair<const std::string*, const Entry*>> sorted() const;
+
+    // Unpack a packed state into dbCount() charges.
+    void unpack(const std::string &packed, int8_t *charges) const;
+
+  private:
+
+    // Set the number of DBs on the first configuration, throws if a later
+    // configuration has a different number of DBs.
+    void checkDBCount(std::size_t t_n_dbs);
+
+    // Insert a packed configuration or add to the count of an existing one.
+    void insert(const std::string &packed, double energy, int count,
+        int physically_valid);
+
+    // Drop the highest energy configurations until the limit is satisfied.
+    void evict();
+
+    typedef std::pair<double, const std::string*> HeapItem;
+
+    std::size_t n_dbs=0;
+    std::size_t max_configs=0;
+    std::unordered_map<std::string, Entry> configs;   // packed state to entry
+    std::priority_queue<HeapItem> heap;               // highest energy on top, if limited
+    std::string key;                                  // reused packing buffer
+  };
+
+  // Result buffer owned by a single plugin thread, obtained from
+  // SiQADConnector::createResultBuffer(). Buffers are not synchronized, so
+  // threads reporting through their own buffers never contend.
+  class ResultBuffer
+  {
+  public:
+    // Accumulate a charge configuration, see
+    // SiQADConnector::accumulateDBCharge().
+    void accumulateDBCharge(const int8_t *charges, std::size_t n_dbs,
+        double energy, int physically_valid=-1)
+    {
+      charge_configs.add(charges, n_dbs, energy, physically_valid);
+    }
+
+    // Add SQCommand export
+    void addSQCommand(SQCommand *command);
+
+  private:
+    friend class SiQADConnector;
+
+    ChargeConfigAccumulator charge_configs;   // accumulated charge configurations
+    std::vector<std::string> export_commands; // SQCommands to be exported
+  };
+#endif
+
+  // verbosity of the connector's console output
+  enum LogLevel {LogSilent, LogInfo, LogDebug};
+
   // SiQAD connector class
   class SiQADConnector
   {
@@ -59,35 +386,154 @@ namespace phys{
     SiQADConnector(const std::string &eng_name, const std::string &input_path,
         const std::string &output_path);
     // DESTRUCTOR
-    ~SiQADConnector()
-    {
-      writeResultsXml();
-    }
+    ~SiQADConnector();
 
-    // Write results to the provided output_path
+    // Write results to the provided output_path. If results have been
+    // streamed, the remaining results are appended and the result file is
+    // finalized. Results can only be finalized once, later calls do nothing.
     void writeResultsXml();
 
 
     // EXPORTING
 
-    // Set export type and variable
+    // Set export type and variable. db_charge rows hold dist, energy and
+    // count, optionally followed by physically_valid (-1 if unspecified) and
+    // state_count.
     void setExport(std::string type, std::vector< std::pair< std::string, std::string > > &data_in);
     void setExport(std::string type, std::vector< std::vector< std::string > > &data_in);
 
+    // Set export type and variable from a contiguous row-major table of
+    // numbers, which is formatted straight into the result file without
+    // intermediate strings, doubles with 12 significant digits and floats at
+    // full float precision. Accepted types and their columns are:
+    //   db_loc:     x, y
+    //   potential:  x, y, potential
+    //   db_pot:     step, x, y, potential
+    //   electrodes: x1, y1, x2, y2, potential
+    void setExport(std::string type, const double *data_in, std::size_t rows, std::size_t cols);
+    void setExport(std::string type, const float *data_in, std::size_t rows, std::size_t cols);
+
+    // Export n_configs charge configurations of n_dbs DBs each. charges holds
+    // the configurations row by row as DB charges in units of e (-1 for DB-,
+    // 0 for DB0 and +1 for DB+) in dbStore() order, energies holds one energy
+    // per configuration. counts (occurrence of each configuration) and
+    // physically_valid are optional, counts default to 1.
+    void setDBChargeExport(const int8_t *charges, std::size_t n_dbs,
+        std::size_t n_configs, const double *energies, const int *counts=nullptr,
+        const int8_t *physically_valid=nullptr);
+
     // Add SQCommand export
     void addSQCommand(SQCommand *);
 
 
+    // STREAMED EXPORTING
+    // Results appended through the following functions are written to the
+    // result file right away rather than held until writeResultsXml(), which
+    // bounds memory usage and leaves readable partial results if the plugin
+    // is terminated. Appending to a different section closes the previous
+    // one, so a section may appear more than once in the result file.
+
+    // Append a charge configuration to the electron distributions. See
+    // setDBChargeExport() for the charge convention, a physically_valid of -1
+    // leaves the validity unspecified.
+    void appendDBCharge(const int8_t *charges, std::size_t n_dbs, double energy,
+        int count=1, int physically_valid=-1);
+    void appendDBCharge(const std::string &dist, const std::string &energy,
+        const std::string &count);
+
+    // Append rows of (x, y, potential) to the potential map.
+    void appendPotentials(const double *data_in, std::size_t rows);
+
+    // Append rows of (step, x, y, potential) to the potentials at DB
+    // locations.
+    void appendDBPotentials(const double *data_in, std::size_t rows);
+
+    // Flush streamed results to disk. Appended results are also flushed
+    // within stream_flush_interval seconds without further calls.
+    void flushResults();
+
+
+    // CHARGE CONFIGURATION ACCUMULATION
+    // Accumulated configurations are deduplicated as they are added and
+    // written to elec_dist in ascending order of energy with their
+    // occurrence counts when the results are written.
+
+    // Accumulate a charge configuration, see setDBChargeExport() for the
+    // charge convention. A physically_valid of -1 leaves the validity
+    // unspecified.
+    void accumulateDBCharge(const int8_t *charges, std::size_t n_dbs,
+        double energy, int physically_valid=-1);
+
+    // Accumulate a charge configuration given as a string of '-', '0' and
+    // '+' characters.
+    void accumulateDBCharge(const std::string &dist, double energy,
+        int physically_valid=-1);
+
+    // Keep only the given number of distinct configurations of lowest energy,
+    // 0 keeps all.
+    void setChargeConfigLimit(std::size_t max_configs);
+
+    // Return the number of distinct accumulated configurations.
+    std::size_t distinctChargeConfigCount() const;
+
+#ifndef SWIG
+    // CONCURRENT EXPORTING
+    // Multithreaded plugins should give each thread its own result buffer
+    // rather than serializing on the connector. Buffers are merged into the
+    // connector's results by mergeResultBuffers() and before results are
+    // written, which must not happen while threads still use their buffers.
+
+    // Return a new result buffer, may be called from any thread.
+    std::shared_ptr<ResultBuffer> createResultBuffer();
+
+    // Move the contents of all result buffers into the connector's results.
+    void mergeResultBuffers();
+#endif
+
+
     // SIMULATION PARAMETERS
 
+    // Simulation parameters are those of the problem file and, once
+    // loadParameterSchema() has been called, the defaults of the parameters
+    // that the problem file leaves out. All accessors below see the same set.
+
     // Checks if a parameter with the given key exists.
-    bool parameterExists(const std::string &key) {return sim_params.find(key) != sim_params.end();}
+    bool parameterExists(const std::string &key) {return typed_params.find(key) != typed_params.end();}
 
     // Get the parameter with the given key.
-    std::string getParameter(const std::string &key) {return sim_params.find(key) != sim_params.end() ? sim_params.at(key) : "";}
+    std::string getParameter(const std::string &key) {return parameterExists(key) ? typed_params.at(key).str : "";}
 
     std::vector<Layer> getLayers(void){return layers;}
-    std::map<std::string, std::string> getAllParameters(void){return sim_params;}
+    std::map<std::string, std::string> getAllParameters(void);
+
+    // Typed access to simulation parameters. Values are parsed once when the
+    // parameters are read, so these are cheap enough to call in loops.
+    // Without a default, a missing parameter throws std::invalid_argument;
+    // a value that does not parse as the requested type always throws.
+    double getDouble(const std::string &key) const;
+    double getDouble(const std::string &key, double default_val) const;
+    int getInt(const std::string &key) const;
+    int getInt(const std::string &key, int default_val) const;
+
+    // Return the index of the parameter value in options, throws
+    // std::invalid_argument if the value is not one of the options.
+    int getEnum(const std::string &key, const std::vector<std::string> &options) const;
+    int getEnum(const std::string &key, const std::vector<std::string> &options,
+        int default_index) const;
+
+    // Validate the simulation parameters against the parameter definitions
+    // in the sim_params node of the given plugin file (*.sqplug or
+    // *.physeng). Every parameter must be defined and parse as its defined
+    // type, ComboBox parameters must take one of their options, and
+    // undefined parameters take their defined default value. Batch mode
+    // variants are validated as well, both those already added and those
+    // added later. Throws std::invalid_argument on the first violation so
+    // that bad parameters are caught before any computation is done.
+    void loadParameterSchema(const std::string &plugin_path);
+
+    // Return the geometry of the design lattice. Defaults to the H-Si(100)-2x1
+    // lattice if the problem file does not specify lattice vectors.
+    const Lattice &getLattice() const {return lattice;}
 
 
     // ITERABLE COLLECTIONS
@@ -96,6 +542,86 @@ namespace phys{
     // across all aggregate levels.
     DBCollection* dbCollection() {return db_col;}
 
+#ifndef SWIG
+    // Return the contiguous DB store, which offers O(1) indexed access to DB
+    // locations in the same order as dbCollection() iteration.
+    const DBStore &dbStore() const {return db_store;}
+#endif
+
+    // Return the number of DBs in the problem.
+    std::size_t dbCount() const {return db_store.size();}
+
+
+    // PAIRWISE DB QUANTITIES
+    // Matrices are computed with vectorizable kernels split across threads on
+    // first use and cached for the lifetime of the connector. Indices follow
+    // dbStore() order.
+
+    // Set the number of threads used to compute pairwise quantities, 0 uses
+    // all available hardware threads.
+    void setThreadCount(int t_num_threads) {num_threads = t_num_threads;}
+
+    // Return the number of threads used to compute pairwise quantities.
+    int threadCount() const;
+
+#ifndef SWIG
+    // Return the pairwise DB distances in angstroms.
+    const PackedSymmetricMatrix<float> &dbDistanceMatrix();
+
+    // Return the screened Coulomb interaction energies V_ij in eV between
+    // singly charged DBs, using the eps_r and debye_length (nm) simulation
+    // parameters. A non-positive debye_length disables screening.
+    const PackedSymmetricMatrix<double> &dbInteractionMatrix();
+
+    // Same as dbInteractionMatrix() with float32 storage, halving the memory
+    // footprint.
+    const PackedSymmetricMatrix<float> &dbInteractionMatrixFloat();
+#endif
+
+    // Return a kernel tabulating the screened Coulomb interaction (see
+    // dbInteractionMatrix()) for every lattice offset within the given cutoff
+    // radius in angstroms. Memory scales with the cutoff rather than the DB
+    // count, making it suitable for layouts too large for a dense matrix. The
+    // kernel is cached until requested with a different cutoff.
+    std::shared_ptr<const LatticeInteractionKernel> latticeInteractionKernel(double cutoff);
+
+
+    // SPATIAL QUERIES
+    // Backed by a grid index over the DB locations which is built on first
+    // use and rebuilt when queried with a radius far from its cell size.
+    // Indices follow dbStore() order.
+
+    // Return the indices of all DBs other than i within r angstroms of DB i.
+    std::vector<int> neighborsWithin(std::size_t i, double r);
+
+    // Group DBs into clusters in which every DB is within cutoff angstroms of
+    // another DB of the same cluster, i.e. the connected components of the
+    // cutoff graph. Returns the cluster index of each DB, clusters being
+    // numbered in order of their first DB.
+    std::vector<int> dbClusters(double cutoff);
+
+
+    // ELECTRODE POTENTIALS
+    // Electrodes are modelled as equipotential patches in the plane of their
+    // layer's zoffset, with the rest of that plane grounded and the substrate
+    // neglected. An electrode at potential V then contributes V*Omega/(2*pi)
+    // at a DB, Omega being the solid angle the electrode subtends at the DB.
+    // Fixed electrodes are at their potential, clocked electrodes at
+    // pot_offset + potential*sin(phase + clock_phase), phases in degrees.
+    // The coupling of all electrodes to all DBs is computed across threads on
+    // first use and cached, after which each clock phase costs O(N) for N
+    // DBs.
+
+    // Return the electrode potentials in volts at all DBs in dbStore() order
+    // for the given clock phase in degrees.
+    std::vector<double> dbElectrodePotentials(double clock_phase=0);
+
+#ifndef SWIG
+    // Write the electrode potentials at all DBs to out, which must hold
+    // dbCount() values.
+    void dbElectrodePotentials(double clock_phase, double *out);
+#endif
+
     // Return pointer to Electrode collection, which allows iteration through
     // electrodes across all electrode layers.
     ElectrodeCollection* electrodeCollection() {return elec_col;}
@@ -104,6 +630,91 @@ namespace phys{
     // electrodes across all electrode layers.
     ElectrodePolyCollection* electrodePolyCollection() {return elec_poly_col;}
 
+#ifndef SWIG
+    // Return the parameters of all rectangular electrodes in
+    // electrodeCollection() order as a row-major table with
+    // electrode_table_cols columns:
+    //   layer_id, x1, y1, x2, y2, potential, phase, electrode_type, net,
+    //   angle, pixel_per_angstrom, pot_offset
+    const std::vector<double> &electrodeTable() const {return elec_table;}
+    static const std::size_t electrode_table_cols = 12;
+#endif
+
+
+    // BATCH MODE
+    // A problem can be solved for several variants of its simulation
+    // parameters in one process, parsing the design only once. Each variant
+    // overrides some of the simulation parameters of the problem file and
+    // writes its results to its own result file.
+
+    // Add a variant with the given parameter overrides. If output_path is
+    // empty, the variant index is appended to the base name of outputPath().
+    void addVariant(const std::map<std::string, std::string> &overrides,
+        const std::string &output_path="");
+
+    // Read variants from an XML file of the form
+    //   <variants>
+    //     <variant output_path="..."><key>value</key>...</variant>
+    //   </variants>
+    // where output_path is optional. Throws if the file cannot be read.
+    void readVariants(const std::string &path);
+
+    // Return the number of variants.
+    std::size_t variantCount() const {return variants.size();}
+
+    // Finish the results of the current variant or of the base problem,
+    // then apply the parameters and result path of the given variant and
+    // clear all exported data. Cached DB interactions are only recomputed if
+    // eps_r or debye_length change.
+    void beginVariant(std::size_t index);
+
+    // Return the index of the current variant, -1 before beginVariant().
+    int currentVariant() const {return current_variant;}
+
+
+    // PROFILING
+    // Time spent in named phases is accumulated and written to eng_info along
+    // with the CPU time and peak memory usage of the process. The connector
+    // times its own parse, setup (DB store and cached pairwise quantities) and
+    // export phases, plugins time theirs (e.g. solve) with the functions below.
+
+    // Start or end timing the given phase. A phase may be entered repeatedly
+    // and its times add up, nested entries of the same phase are only timed
+    // once.
+    void startPhase(const std::string &name);
+    void endPhase(const std::string &name);
+
+    // Return the time in seconds accumulated in the given phase so far.
+    double phaseTime(const std::string &name);
+
+#ifndef SWIG
+    // Times the given phase for the lifetime of the object.
+    class ScopedPhase
+    {
+    public:
+      ScopedPhase(SiQADConnector &conn, const std::string &name)
+        : conn(conn), name(name) {conn.startPhase(name);}
+      ~ScopedPhase() {conn.endPhase(name);}
+    private:
+      SiQADConnector &conn;
+      std::string name;
+    };
+#endif
+
+
+    // LOGGING
+    // Console output is filtered by log level. LogInfo reports progress once
+    // per problem or result section, LogDebug additionally reports every item
+    // read or exported. The level defaults to LogInfo and can be set with the
+    // log_level simulation parameter or the SIQADCONN_LOG_LEVEL environment
+    // variable (silent, info or debug), the latter taking precedence.
+
+    // Set the log level.
+    void setLogLevel(LogLevel level) {log_level = level;}
+
+    // Return the log level.
+    LogLevel logLevel() const {return log_level;}
+
 
     // Misc Accessors
     std::string inputPath(){return input_path;}
@@ -113,36 +724,131 @@ namespace phys{
 
   private:
 
-    // Read the problem file
+    // Read the problem file. The file is streamed through XMLStreamReader so
+    // the connector never holds more than the current element in memory.
     void readProblem(const std::string &path);
 
     // Read program properties
-    void readProgramProp(const bpt::ptree &);
+    void readProgramProp(XMLStreamReader &);
 
     // Read layer properties
-    void readLayers(const bpt::ptree &);
-    void readLayerProp(const bpt::ptree &);
+    void readLayers(XMLStreamReader &);
+    void readLayerProp(XMLStreamReader &);
+    void readLatticeVectors(XMLStreamReader &);
 
     // Read simulation parameters
-    void readSimulationParam(const bpt::ptree &);
+    void readSimulationParam(XMLStreamReader &);
+
+    // Parsed simulation parameter
+    struct ParamValue {
+      std::string str;
+      double d=0;
+      int i=0;
+      bool is_double=false;   // str parses as a double
+      bool is_int=false;      // str parses as an int
+    };
+
+    // Simulation parameter definition of a plugin file
+    struct ParamDef {
+      std::string type;                 // bool, int, float, double or string
+      std::string default_val;
+      std::vector<std::string> options; // allowed values, empty if any
+    };
+
+    // Parse sim_params into typed_params, validating them against the
+    // parameter schema if one has been loaded.
+    void parseParameters();
+
+    // Throw std::invalid_argument if the given parameters violate the
+    // parameter schema.
+    void validateParameters(const std::map<std::string, std::string> &params) const;
+
+    // Return the parsed parameter of the given key, nullptr if missing.
+    const ParamValue *findParameter(const std::string &key) const;
+
+    // Parse a parameter value.
+    static ParamValue parseParamValue(const std::string &str);
+
+    // Throw std::invalid_argument if the value violates the definition.
+    static void checkParameter(const std::string &key, const std::string &val,
+        const ParamDef &def);
+
+    // Return the stream for messages of the given level, which discards
+    // them unless the level is enabled. Messages end with '\n' rather than
+    // std::endl so that output stays buffered. Per-item messages check
+    // logEnabled() first so that they aren't formatted only to be discarded.
+    std::ostream &log(LogLevel level);
+
+    // Return whether messages of the given level are printed.
+    bool logEnabled(LogLevel level) const {return level != LogSilent && level <= log_level;}
+
+    // Set the log level from its name, returns false if the name is unknown.
+    bool setLogLevel(const std::string &name);
+
+    // Clear exported data and runtime information for a new set of results.
+    void resetResults();
+
+    // Return whether anything has been exported since the last reset.
+    bool hasPendingResults();
 
     // Read design
-    void readDesign(const bpt::ptree &, const std::shared_ptr<Aggregate> &);
-    void readItemTree(const bpt::ptree &, const std::shared_ptr<Aggregate> &);
-    void readElectrode(const bpt::ptree &, const std::shared_ptr<Aggregate> &);
-    void readElectrodePoly(const bpt::ptree &, const std::shared_ptr<Aggregate> &);
-    void readDBDot(const bpt::ptree &, const std::shared_ptr<Aggregate> &);
-
-    // Generate property trees for writing
-    bpt::ptree engInfoPropertyTree();
-    bpt::ptree simParamsPropertyTree();
-    bpt::ptree dbLocPropertyTree();
-    bpt::ptree dbChargePropertyTree();
-    bpt::ptree electrodePropertyTree();
-    // bpt::ptree electrodePolyPropertyTree();
-    bpt::ptree potentialPropertyTree();
-    bpt::ptree dbPotentialPropertyTree(); // TODO fix up this function, a lot of redundant information
-    bpt::ptree sqCommandsPropertyTree();
+    void readDesign(XMLStreamReader &, const std::shared_ptr<Aggregate> &);
+    void readItemTree(XMLStreamReader &, const std::shared_ptr<Aggregate> &);
+    void readElectrode(XMLStreamReader &, const std::shared_ptr<Aggregate> &);
+    void readElectrodePoly(XMLStreamReader &, const std::shared_ptr<Aggregate> &);
+    void readDBDot(XMLStreamReader &, const std::shared_ptr<Aggregate> &);
+
+    // Return the screened Coulomb interaction defined by the eps_r and
+    // debye_length simulation parameters, throws if they are missing.
+    ScreenedCoulomb screenedCoulomb();
+
+    // Return a spatial index suited to queries of radius r.
+    std::shared_ptr<const DBSpatialIndex> spatialIndex(double r);
+
+    // Compute the screened Coulomb interaction matrix with the given storage.
+    template <typename T>
+    void computeDBInteractions(PackedSymmetricMatrix<T> &mat);
+
+    // Electrode potentials at all DBs, the potential at clock phase p being
+    // fixed + cos(p)*cos_coef + sin(p)*sin_coef.
+    struct ElectrodeCoupling {
+      std::vector<double> fixed, cos_coef, sin_coef;
+    };
+
+    // Return the electrode coupling, computing it on first use.
+    std::shared_ptr<const ElectrodeCoupling> electrodeCoupling();
+
+    // Write result sections
+    void writeEngInfo(XMLStreamWriter &);
+    void writeSimParams(XMLStreamWriter &);
+    void writeDBLocations(XMLStreamWriter &);
+    void writeDBCharges(XMLStreamWriter &);
+    void writeElectrodes(XMLStreamWriter &);
+    void writePotentials(XMLStreamWriter &);
+    void writeDBPotentials(XMLStreamWriter &); // TODO fix up this function, a lot of redundant information
+    void writeSQCommands(XMLStreamWriter &);
+
+    // Open the result file and write the document header, returns false if
+    // the file cannot be opened.
+    bool openResultStream();
+
+    // Return the writer for the given streamed section, opening the result
+    // file and switching sections as needed. Throws if the results have
+    // already been finalized or the result file cannot be opened.
+    XMLStreamWriter &streamedSection(const char *name);
+
+    // Close the open streamed section if any.
+    void endStreamedSection();
+
+    // Flush streamed results if the flush interval has passed, otherwise
+    // leave them to the flusher thread of the result stream. The caller must
+    // hold result_stream_mutex.
+    void resultsAppended();
+
+    // Store a typed export table.
+    template <typename T>
+    void setTypedExport(const std::string &type, const T *data_in,
+        std::size_t rows, std::size_t cols);
 
     // Engine properties
     std::string eng_name;                 // name of simulation engine
@@ -153,12 +859,28 @@ namespace phys{
     ElectrodeCollection* elec_col;
     DBCollection* db_col;
     ElectrodePolyCollection* elec_poly_col;
+    DBStore db_store;
+    std::vector<double> elec_table;
+
+    // Cached pairwise DB quantities
+    int num_threads=0;
+    std::mutex pairwise_mutex;
+    std::shared_ptr<PackedSymmetricMatrix<float>> db_dist_mat;
+    std::shared_ptr<PackedSymmetricMatrix<double>> db_interaction_mat;
+    std::shared_ptr<PackedSymmetricMatrix<float>> db_interaction_mat_f;
+    std::shared_ptr<const LatticeInteractionKernel> lattice_kernel;
+    std::shared_ptr<const DBSpatialIndex> spatial_index;
+    std::shared_ptr<const ElectrodeCoupling> electrode_coupling;
 
     // Retrieved items and properties
     std::map<std::string, std::string> program_props; // SiQAD properties
     std::shared_ptr<Aggregate> item_tree;             // all physical items
     std::vector<Layer> layers;                        // layers
+    Lattice lattice;                                  // lattice geometry
     std::map<std::string, std::string> sim_params;    // simulation parameters
+    std::unordered_map<std::string, ParamValue> typed_params; // parsed sim_params
+    std::map<std::string, ParamDef> param_schema;             // parameter definitions
+    bool param_schema_loaded=false;
 
     // Exportable data
     std::vector<std::vector<std::string>> pot_data;
@@ -169,6 +891,60 @@ namespace phys{
     std::vector<std::vector<std::string>> db_charge_data;       // pair of elec dist and energy
     std::vector<std::string> export_commands;                   // SQCommands to be exported
 
+    // Typed exportable data, each stored as a row-major table which takes
+    // precedence over the string data of the same export type
+    struct ExportTable {
+      std::vector<double> values;
+      std::size_t cols=0;
+      bool single_precision=false;  // values were exported from floats
+      std::size_t rows() const {return cols ? values.size() / cols : 0;}
+      double at(std::size_t row, std::size_t col) const {return values[row*cols+col];}
+    };
+    std::map<std::string, ExportTable> typed_exports;
+    struct ChargeExport {
+      std::size_t n_dbs=0;
+      std::vector<int8_t> charges;
+      std::vector<double> energies;
+      std::vector<int> counts;
+      std::vector<int8_t> physically_valid;
+    };
+    ChargeExport charge_export;
+    ChargeConfigAccumulator charge_configs;   // accumulated charge configurations
+
+    // Per-thread result buffers
+    std::mutex result_buffers_mutex;
+    std::vector<std::shared_ptr<ResultBuffer>> result_buffers;
+
+    // Streamed results
+    std::mutex result_stream_mutex;               // serializes appends and flushes
+    std::unique_ptr<ResultStream> result_stream;  // open result file, if any
+    bool results_finalized=false;                 // result file has been completed
+    static constexpr double stream_flush_interval=1.; // seconds between automatic flushes
+
+    // Batch mode
+    struct Variant {
+      std::map<std::string, std::string> overrides;
+      std::string output_path;
+    };
+    std::vector<Variant> variants;
+    std::map<std::string, std::string> base_sim_params; // parameters of the problem file
+    std::string base_output_path;                       // output path given to the constructor
+    int current_variant=-1;
+
+    // Profiling
+    struct Phase {
+      std::string name;
+      double elapsed=0;     // accumulated seconds of completed entries
+      int depth=0;          // number of open entries
+      std::chrono::steady_clock::time_point start;
+    };
+    std::vector<Phase> phases;  // in order of first entry
+    std::mutex phases_mutex;
+
+    // Logging
+    LogLevel log_level=LogInfo;
+    bool log_level_from_env=false;  // log level set by SIQADCONN_LOG_LEVEL
+
     // Runtime information
     int return_code=0;
     std::chrono::time_point<std::chrono::system_clock> start_time;
@@ -195,40 +971,38 @@ namespace phys{
       : x(in_x), y(in_y), n(n), m(m), l(l) {};
   };
 
-  // a constant iterator that iterates through all dangling bonds in the problem
+  // a constant iterator that iterates through all dangling bonds in the problem,
+  // implemented as a view over the contiguous DBStore
   class DBIterator
   {
   public:
-    explicit DBIterator(std::shared_ptr<Aggregate> root, bool begin=true);
+    explicit DBIterator(const DBStore *store, bool begin=true);
 
-    DBIterator& operator++(); // recursive part here
-    bool operator==(const DBIterator &other) {return other.db_iter == db_iter;}
-    bool operator!=(const DBIterator &other) {return other.db_iter != db_iter;}
-    std::shared_ptr<DBDot> operator*() const {return *db_iter;}
+    DBIterator& operator++() {++ind; return *this;}
+    bool operator==(const DBIterator &other) {return other.ind == ind;}
+    bool operator!=(const DBIterator &other) {return other.ind != ind;}
+    std::shared_ptr<DBDot> operator*() const;
+
+    // Return the DBStore index of the current DB.
+    std::size_t index() const {return ind;}
 
     void setCollection(DBCollection *coll) {collection = coll;}
     DBCollection *collection; // needed for python wrapper
   private:
 
-    DBIter db_iter;                   // points to the current DB
-    std::shared_ptr<Aggregate> curr;  // current working Aggregate
-    std::stack<std::pair<std::shared_ptr<Aggregate>, AggIter>> agg_stack;
-
-    // add a new aggregate pair to the stack
-    void push(std::shared_ptr<Aggregate> agg);
-
-    // pop the aggregate stack
-    void pop();
+    const DBStore *store;   // store being iterated over
+    std::size_t ind;        // index of the current DB in the store
   };
 
   class DBCollection
   {
   public:
-    DBCollection(std::shared_ptr<Aggregate> db_tree_in)
-      : db_tree_inner(db_tree_in) {};
-    DBIterator begin() {return DBIterator(db_tree_inner);}
-    DBIterator end() {return DBIterator(db_tree_inner, false);}
+    DBCollection(std::shared_ptr<Aggregate> db_tree_in, const DBStore *db_store_in)
+      : db_tree_inner(db_tree_in), db_store_inner(db_store_in) {};
+    DBIterator begin() {return DBIterator(db_store_inner);}
+    DBIterator end() {return DBIterator(db_store_inner, false);}
     std::shared_ptr<Aggregate> db_tree_inner;
+    const DBStore *db_store_inner;
   };
 
 
@@ -241,6 +1015,7 @@ namespace phys{
     int electrode_type;
     int net;
     double pixel_per_angstrom;
+    double pot_offset=0;  // potential offset of clocked electrodes
     ElectrodePoly(int in_layer_id, std::vector<std::pair<double, double>> in_vertices, \
               double in_potential, double in_phase, int in_electrode_type, double in_pixel_per_angstrom, int in_net)
       : layer_id(in_layer_id), vertices(in_vertices), \
@@ -282,13 +1057,14 @@ namespace phys{
   // electrode
   struct Electrode {
     int layer_id;
-    double x1,x2,y1,y2;      // pixel location of electrode.
+    double x1,x2,y1,y2;      // location of electrode in angstroms before rotation
     double potential;  // voltage that the electrode is set to
     double phase;
     int electrode_type;
     int net;
-    double angle;
+    double angle;      // rotation about the center in degrees
     double pixel_per_angstrom;
+    double pot_offset=0;  // potential offset of clocked electrodes
     Electrode(int in_layer_id, double in_x1, double in_x2, double in_y1, double in_y2, \
               double in_potential, double in_phase, int in_electrode_type, double in_pixel_per_angstrom, int in_net, double in_angle)
       : layer_id(in_layer_id), x1(in_x1), x2(in_x2), y1(in_y1), y2(in_y2), \
@@ -336,6 +1112,11 @@ namespace phys{
     std::vector<std::shared_ptr<Electrode>> elecs;
     std::vector<std::shared_ptr<ElectrodePoly>> elec_polys;
 
+    // Index range [db_begin, db_end) in DBStore of the DBs contained in this
+    // aggregate and its children, set when the DBStore is built.
+    std::size_t db_begin=0;
+    std::size_t db_end=0;
+
     // Properties
     int size(); // returns the number of contained elecs, including those in children aggs
   };
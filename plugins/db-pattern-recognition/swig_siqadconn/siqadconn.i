@@ -25,6 +25,7 @@ namespace std {
     %template(FloatPair) pair<float, float>;
     %template(FloatPairVector) vector< pair <float, float> >;
     %template(IntVector) vector<int>;
+    %template(DoubleVector) vector<double>;
     %template(StringPair) pair<string, string>;
     %template(StringPairVector) vector< pair<string, string> >;
     %template(StringVector) vector<string>;
@@ -38,6 +39,151 @@ namespace std {
 #define SWIG_PYTHON_2_UNICODE
 %}
 
+// Zero-copy buffer access. Connector arrays are handed to Python as
+// memoryviews over the connector's own memory. The views keep the connector
+// alive and stay valid as long as its problem is not reloaded. Numeric results are
+// read from any C-contiguous buffer (NumPy arrays, array.array, memoryview)
+// without converting each element to a Python object.
+%{
+#include <cstring>
+
+// Python object exporting a read-only buffer over connector memory, holding a
+// reference to the connector's Python object so that views over the buffer
+// keep the connector alive.
+struct SiQADConnArray
+{
+  PyObject_HEAD
+  PyObject *owner;
+  char *data;
+  Py_ssize_t bytes;
+};
+
+static int siqadconnArrayGetBuffer(PyObject *obj, Py_buffer *view, int flags)
+{
+  SiQADConnArray *arr = reinterpret_cast<SiQADConnArray*>(obj);
+  return PyBuffer_FillInfo(view, obj, arr->data, arr->bytes, 1, flags);
+}
+
+static void siqadconnArrayDealloc(PyObject *obj)
+{
+  PyTypeObject *type = Py_TYPE(obj);
+  Py_XDECREF(reinterpret_cast<SiQADConnArray*>(obj)->owner);
+  PyObject_Del(obj);
+#if PY_VERSION_HEX >= 0x03080000
+  // instances of heap types hold a reference to their type
+  Py_DECREF(type);
+#endif
+}
+
+// Return the SiQADConnArray type, created on first use.
+static PyTypeObject *siqadconnArrayType()
+{
+  static PyObject *type = NULL;
+  if (type == NULL) {
+    static PyType_Slot slots[] = {
+      {Py_tp_dealloc, reinterpret_cast<void*>(siqadconnArrayDealloc)},
+      {Py_bf_getbuffer, reinterpret_cast<void*>(siqadconnArrayGetBuffer)},
+      {0, NULL}
+    };
+    static PyType_Spec spec = {"siqadconn._ConnectorArray",
+      sizeof(SiQADConnArray), 0, Py_TPFLAGS_DEFAULT, slots};
+    type = PyType_FromSpec(&spec);
+  }
+  return reinterpret_cast<PyTypeObject*>(type);
+}
+
+// Return a read-only memoryview over the given bytes owned by owner, which is
+// kept alive for as long as the memoryview or any view derived from it.
+static PyObject *siqadconnRawView(PyObject *owner, const void *data, std::size_t bytes)
+{
+  static char empty = 0;
+  PyTypeObject *type = siqadconnArrayType();
+  if (type == NULL)
+    return NULL;
+  SiQADConnArray *arr = PyObject_New(SiQADConnArray, type);
+  if (arr == NULL)
+    return NULL;
+  Py_INCREF(owner);
+  arr->owner = owner;
+  arr->data = bytes ? const_cast<char*>(static_cast<const char*>(data)) : &empty;
+  arr->bytes = static_cast<Py_ssize_t>(bytes);
+  PyObject *view = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(arr));
+  Py_DECREF(arr);
+  return view;
+}
+
+// C-contiguous buffer of a Python object with items of type T, released on
+// destruction. ok() is false with a Python exception set if obj doesn't
+// export such a buffer.
+template <typename T>
+class SiQADConnBuffer
+{
+public:
+  SiQADConnBuffer(PyObject *obj, const char *formats, const char *name)
+  {
+    if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+      PyErr_Format(PyExc_TypeError, "%s must support the buffer protocol", name);
+      return;
+    }
+    acquired = true;
+    const char *fmt = view.format ? view.format : "B";
+    if (*fmt == '@' || *fmt == '=' || *fmt == '<')
+      fmt++;
+    if (view.itemsize != sizeof(T) || std::strlen(fmt) != 1 || !std::strchr(formats, *fmt)) {
+      PyErr_Format(PyExc_TypeError, "%s has item format '%s', expected one of '%s'",
+          name, view.format ? view.format : "B", formats);
+      return;
+    }
+    valid = true;
+  }
+  ~SiQADConnBuffer() {if (acquired) PyBuffer_Release(&view);}
+
+  bool ok() const {return valid;}
+  const T *data() const {return static_cast<const T*>(view.buf);}
+  std::size_t size() const {return static_cast<std::size_t>(view.len) / sizeof(T);}
+  int ndim() const {return view.ndim;}
+  std::size_t shape(int i) const
+  {
+    return view.shape ? static_cast<std::size_t>(view.shape[i]) : size();
+  }
+
+  // Return the number of rows and columns of a 1-D or 2-D buffer, with a
+  // 1-D buffer taken as a single column.
+  bool matrixShape(const char *name, std::size_t &rows, std::size_t &cols) const
+  {
+    if (ndim() == 1 || ndim() == 0) {
+      rows = size();
+      cols = 1;
+    } else if (ndim() == 2) {
+      rows = shape(0);
+      cols = shape(1);
+    } else {
+      PyErr_Format(PyExc_ValueError, "%s must be 1 or 2 dimensional", name);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  Py_buffer view;
+  bool acquired=false;
+  bool valid=false;
+};
+
+// Raise the C++ exception currently being handled as a Python ValueError.
+static PyObject *siqadconnRaise()
+{
+  try {
+    throw;
+  } catch (const std::exception &e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+  } catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "unknown error in SiQADConnector");
+  }
+  return NULL;
+}
+%}
+
 
 %feature("shadow") phys::DBIterator::__next__() %{
   def __next__(self):
@@ -67,13 +213,171 @@ namespace std {
 %}
 
 %extend phys::SiQADConnector {
+  PyObject *_dbArrayBytes(const std::string &name, PyObject *owner) {
+    const phys::DBStore &store = $self->dbStore();
+    if (name == "x")
+      return siqadconnRawView(owner, store.x.data(), store.x.size()*sizeof(float));
+    if (name == "y")
+      return siqadconnRawView(owner, store.y.data(), store.y.size()*sizeof(float));
+    const phys::AlignedVector<int> *arr = name == "n" ? &store.n
+      : name == "m" ? &store.m : name == "l" ? &store.l : NULL;
+    if (arr == NULL) {
+      PyErr_Format(PyExc_KeyError, "unknown DB array '%s'", name.c_str());
+      return NULL;
+    }
+    return siqadconnRawView(owner, arr->data(), arr->size()*sizeof(int));
+  }
+
+  PyObject *_electrodeTableBytes(PyObject *owner) {
+    const std::vector<double> &table = $self->electrodeTable();
+    return siqadconnRawView(owner, table.data(), table.size()*sizeof(double));
+  }
+
+  PyObject *_setExportBuffer(const std::string &type, PyObject *obj) {
+    std::size_t rows, cols;
+    try {
+      SiQADConnBuffer<double> dbuf(obj, "d", type.c_str());
+      if (dbuf.ok()) {
+        if (!dbuf.matrixShape(type.c_str(), rows, cols))
+          return NULL;
+        $self->setExport(type, dbuf.data(), rows, cols);
+        Py_RETURN_NONE;
+      }
+      PyErr_Clear();
+      SiQADConnBuffer<float> fbuf(obj, "f", type.c_str());
+      if (!fbuf.ok()) {
+        PyErr_Clear();
+        PyErr_Format(PyExc_TypeError, "%s must be a float32 or float64 buffer", type.c_str());
+        return NULL;
+      }
+      if (!fbuf.matrixShape(type.c_str(), rows, cols))
+        return NULL;
+      $self->setExport(type, fbuf.data(), rows, cols);
+      Py_RETURN_NONE;
+    } catch (...) {
+      return siqadconnRaise();
+    }
+  }
+
+  PyObject *_setDBChargeExportBuffer(PyObject *charges, PyObject *energies,
+      PyObject *counts, PyObject *physically_valid) {
+    try {
+      std::size_t n_configs, n_dbs;
+      SiQADConnBuffer<int8_t> cbuf(charges, "bB?", "charges");
+      if (!cbuf.ok() || !cbuf.matrixShape("charges", n_configs, n_dbs))
+        return NULL;
+      SiQADConnBuffer<double> ebuf(energies, "d", "energies");
+      if (!ebuf.ok())
+        return NULL;
+      if (cbuf.ndim() < 2) {
+        n_dbs = n_configs;
+        n_configs = 1;
+      }
+      if (ebuf.size() != n_configs) {
+        PyErr_SetString(PyExc_ValueError, "energies must hold one value per configuration");
+        return NULL;
+      }
+      std::unique_ptr<SiQADConnBuffer<int> > nbuf;
+      std::unique_ptr<SiQADConnBuffer<int8_t> > vbuf;
+      if (counts != Py_None) {
+        nbuf.reset(new SiQADConnBuffer<int>(counts, "i", "counts"));
+        if (!nbuf->ok())
+          return NULL;
+        if (nbuf->size() != n_configs) {
+          PyErr_SetString(PyExc_ValueError, "counts must hold one value per configuration");
+          return NULL;
+        }
+      }
+      if (physically_valid != Py_None) {
+        vbuf.reset(new SiQADConnBuffer<int8_t>(physically_valid, "bB?", "physically_valid"));
+        if (!vbuf->ok())
+          return NULL;
+        if (vbuf->size() != n_configs) {
+          PyErr_SetString(PyExc_ValueError, "physically_valid must hold one value per configuration");
+          return NULL;
+        }
+      }
+      $self->setDBChargeExport(cbuf.data(), n_dbs, n_configs, ebuf.data(),
+          nbuf ? nbuf->data() : nullptr, vbuf ? vbuf->data() : nullptr);
+      Py_RETURN_NONE;
+    } catch (...) {
+      return siqadconnRaise();
+    }
+  }
+
+  PyObject *_appendPotentialsBuffer(PyObject *obj, bool at_dbs) {
+    try {
+      const int cols = at_dbs ? 4 : 3;
+      SiQADConnBuffer<double> buf(obj, "d", "potentials");
+      if (!buf.ok())
+        return NULL;
+      if (buf.size() % cols != 0 || (buf.ndim() == 2 && buf.shape(1) != static_cast<std::size_t>(cols))) {
+        PyErr_Format(PyExc_ValueError, "potentials must have %d columns", cols);
+        return NULL;
+      }
+      if (at_dbs)
+        $self->appendDBPotentials(buf.data(), buf.size()/cols);
+      else
+        $self->appendPotentials(buf.data(), buf.size()/cols);
+      Py_RETURN_NONE;
+    } catch (...) {
+      return siqadconnRaise();
+    }
+  }
+
+  %pythoncode{
+    def dbArray(self, name):
+      """Return a zero-copy memoryview over the DB store array of the given
+      name in dbCollection() order: 'x' and 'y' (float32 locations in
+      angstroms) or 'n', 'm' and 'l' (int32 lattice coordinates). Wrap it
+      with numpy.asarray() for a NumPy view. The view keeps the connector
+      alive and is only valid until its problem is reloaded."""
+      return self._dbArrayBytes(name, self).cast('f' if name in ('x', 'y') else 'i')
+  }
+  %pythoncode{
+    def dbLocations(self):
+      """Return zero-copy memoryviews (x, y) over the DB locations."""
+      return self.dbArray('x'), self.dbArray('y')
+  }
+  %pythoncode{
+    def electrodeArray(self):
+      """Return a zero-copy (n, 12) float64 memoryview over the rectangular
+      electrodes with columns layer_id, x1, y1, x2, y2, potential, phase,
+      electrode_type, net, angle, pixel_per_angstrom, pot_offset."""
+      raw = self._electrodeTableBytes(self)
+      return raw.cast('d', (len(raw) // (12 * 8), 12)) if len(raw) else raw.cast('d')
+  }
+  %pythoncode{
+    def appendPotentialArray(self, data, at_dbs=False):
+      """Append a float64 buffer of (x, y, potential) rows to the potential
+      map, or of (step, x, y, potential) rows to the DB potentials if
+      at_dbs is set."""
+      self._appendPotentialsBuffer(data, at_dbs)
+  }
   %pythoncode{
     def export(self, *args, **kwargs):
       for key in kwargs:
-        if key == 'db_loc':
-            self.setExport(key, StringPairVector(self.tuplify(kwargs[key])))
+        val = kwargs[key]
+        if key == 'db_charge' and isinstance(val, dict):
+            self._setDBChargeExportBuffer(val['charges'], val['energies'],
+                val.get('counts'), val.get('physically_valid'))
+        elif key != 'db_charge' and self._isFloatBuffer(val):
+            self._setExportBuffer(key, val)
+        elif key == 'db_loc':
+            self.setExport(key, StringPairVector(self.tuplify(val)))
         else:
-            self.setExport(key, StringVector2D(self.tuplify(kwargs[key])))
+            self.setExport(key, StringVector2D(self.tuplify(val)))
+  }
+  %pythoncode{
+    @staticmethod
+    def _isFloatBuffer(data):
+      # only float32 and float64 buffers are exported without conversion, 
+      # anything else goes through tuplify()
+      try:
+        fmt = memoryview(data).format
+      except TypeError:
+        return False
+      return fmt.lstrip('@=<') in ('f', 'd')
   }
   %pythoncode{
     def addCommand(self, *args, **kwargs):
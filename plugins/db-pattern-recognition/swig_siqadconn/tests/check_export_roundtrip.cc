@@ -0,0 +1,171 @@
+// @file:     check_export_roundtrip.cc
+// @license:  Apache License 2.0
+//
+// @desc:     Check that the typed double, float and int8 exports write the
+//            same result file sections as the string exports given the same
+//            numbers formatted at the precision of their type.
+
+#include "siqadconn.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// problem file with a single DB, enough to construct a connector
+static const char *problem_xml =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<siqad>\n"
+  "  <sim_params><num_threads>1</num_threads></sim_params>\n"
+  "  <layers><layer_prop><name>Surface</name><type>DB</type>"
+  "<zoffset>0</zoffset><zheight>0</zheight></layer_prop></layers>\n"
+  "  <design><layer type=\"DB\"><dbdot><layer_id>2</layer_id>"
+  "<latcoord n=\"0\" m=\"0\" l=\"0\"/><physloc x=\"0\" y=\"0\"/></dbdot>"
+  "</layer></design>\n</siqad>\n";
+
+static const std::size_t n_rows = 50;
+static const std::size_t n_dbs = 7;
+
+static std::string format(double value)
+{
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.12g", value);
+  return buf;
+}
+
+static std::string format(float value)
+{
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.9g", value);
+  return buf;
+}
+
+static std::string readFile(const std::string &path)
+{
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// text of the first element with the given name, including its tags
+static std::string section(const std::string &xml, const std::string &name)
+{
+  std::size_t begin = xml.find("<" + name + ">");
+  std::size_t end = xml.find("</" + name + ">");
+  if (begin == std::string::npos || end == std::string::npos)
+    return std::string();
+  return xml.substr(begin, end + name.size() + 3 - begin);
+}
+
+// sample table of rows x cols values with a mix of magnitudes and signs
+template <typename T>
+static std::vector<T> sampleTable(std::size_t rows, std::size_t cols)
+{
+  std::vector<T> values(rows*cols);
+  for (std::size_t i = 0; i < values.size(); i++)
+    values[i] = static_cast<T>((i % 3 == 0 ? -1. : 1.) * (0.1 + i*1.37e-3) * (i % 5 == 0 ? 1e-7 : 3.));
+  return values;
+}
+
+template <typename T>
+static std::vector<std::vector<std::string>> stringTable(const std::vector<T> &values, std::size_t cols)
+{
+  std::vector<std::vector<std::string>> table(values.size() / cols);
+  for (std::size_t i = 0; i < values.size(); i++)
+    table[i / cols].push_back(format(values[i]));
+  return table;
+}
+
+// write results through the string or the typed exports and return the file
+template <typename T>
+static std::string writeResults(const std::string &problem_path,
+    const std::string &result_path, bool typed)
+{
+  std::vector<T> pot = sampleTable<T>(n_rows, 3);
+  std::vector<T> db_pot = sampleTable<T>(n_rows, 4);
+  std::vector<T> elecs = sampleTable<T>(n_rows, 5);
+  std::vector<T> db_loc = sampleTable<T>(n_rows, 2);
+
+  std::vector<int8_t> charges(n_rows*n_dbs);
+  std::vector<double> energies(n_rows);
+  std::vector<int> counts(n_rows);
+  std::vector<int8_t> valid(n_rows);
+  for (std::size_t i = 0; i < n_rows; i++) {
+    for (std::size_t j = 0; j < n_dbs; j++)
+      charges[i*n_dbs+j] = static_cast<int8_t>((i + j) % 3) - 1;
+    energies[i] = -0.0123 * i + 1e-9;
+    counts[i] = static_cast<int>(i % 4 + 1);
+    valid[i] = i % 2;
+  }
+
+  {
+    phys::SiQADConnector conn("check_export_roundtrip", problem_path, result_path);
+    conn.setLogLevel(phys::LogSilent);
+    if (typed) {
+      conn.setExport("potential", pot.data(), n_rows, 3);
+      conn.setExport("db_pot", db_pot.data(), n_rows, 4);
+      conn.setExport("electrodes", elecs.data(), n_rows, 5);
+      conn.setExport("db_loc", db_loc.data(), n_rows, 2);
+      conn.setDBChargeExport(charges.data(), n_dbs, n_rows, energies.data(),
+          counts.data(), valid.data());
+    } else {
+      std::vector<std::vector<std::string>> pot_s = stringTable(pot, 3);
+      std::vector<std::vector<std::string>> db_pot_s = stringTable(db_pot, 4);
+      std::vector<std::vector<std::string>> elecs_s = stringTable(elecs, 5);
+      std::vector<std::pair<std::string, std::string>> db_loc_s;
+      for (std::size_t i = 0; i < n_rows; i++)
+        db_loc_s.push_back(std::make_pair(format(db_loc[2*i]), format(db_loc[2*i+1])));
+      std::vector<std::vector<std::string>> charges_s;
+      for (std::size_t i = 0; i < n_rows; i++) {
+        std::string dist;
+        for (std::size_t j = 0; j < n_dbs; j++) {
+          int8_t q = charges[i*n_dbs+j];
+          dist += q < 0 ? '-' : (q > 0 ? '+' : '0');
+        }
+        charges_s.push_back({dist, format(energies[i]), std::to_string(counts[i]),
+            std::to_string(valid[i]), "3"});
+      }
+      conn.setExport("potential", pot_s);
+      conn.setExport("db_pot", db_pot_s);
+      conn.setExport("electrodes", elecs_s);
+      conn.setExport("db_loc", db_loc_s);
+      conn.setExport("db_charge", charges_s);
+    }
+  }
+  return readFile(result_path);
+}
+
+template <typename T>
+static int check(const std::string &problem_path, const std::string &dir,
+    const std::string &type_name)
+{
+  std::string from_strings = writeResults<T>(problem_path, dir + "/roundtrip_string.xml", false);
+  std::string from_typed = writeResults<T>(problem_path, dir + "/roundtrip_" + type_name + ".xml", true);
+
+  int failures = 0;
+  for (const char *name : {"potential_map", "elec_dist", "electrode", "dbdots", "physloc"}) {
+    std::string expected = section(from_strings, name);
+    std::string actual = section(from_typed, name);
+    if (expected.empty() || expected != actual) {
+      std::cerr << "FAIL: " << type_name << " " << name << " differs from the string export"
+                << std::endl;
+      failures++;
+    }
+  }
+  std::cout << (failures ? "FAIL: " : "PASS: ") << type_name << " exports" << std::endl;
+  return failures;
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : ".";
+  std::string problem_path = dir + "/roundtrip_problem.xml";
+  std::ofstream(problem_path) << problem_xml;
+
+  int failures = check<double>(problem_path, dir, "double")
+      + check<float>(problem_path, dir, "float");
+  return failures ? 1 : 0;
+}
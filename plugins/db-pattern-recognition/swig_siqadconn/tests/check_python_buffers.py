@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+# encoding: utf-8
+
+'''
+Check the zero-copy buffer access of the Python wrapper: views returned by
+dbArray() and electrodeArray() keep the connector alive after it is deleted,
+and only float32/float64 buffers take the typed export path.
+'''
+
+__copyright__   = 'Apache License 2.0'
+
+from argparse import ArgumentParser
+from array import array
+import gc
+import os
+import sys
+import weakref
+
+def check(name, passed):
+    print('%s: %s' % ('PASS' if passed else 'FAIL', name),
+            file=sys.stdout if passed else sys.stderr)
+    return 0 if passed else 1
+
+def raises(exc_type, fn, *args):
+    try:
+        fn(*args)
+    except exc_type:
+        return True
+    return False
+
+def check_views(siqadconn, problem, result):
+    failures = 0
+    conn = siqadconn.SiQADConnector('check_python_buffers', problem, result)
+    conn_ref = weakref.ref(conn)
+    x = conn.dbArray('x')
+    elecs = conn.electrodeArray()
+    n_dbs = conn.dbCount()
+    del conn
+    gc.collect()
+    failures += check('views keep the connector alive after del', conn_ref() is not None)
+    failures += check('dbArray() readable after del', len(x) == n_dbs and x[2] > 0)
+    failures += check('electrodeArray() readable after del',
+            elecs.shape == (3, 12) and abs(elecs[2, 5] - 0.3) < 1e-12)
+    del x
+    gc.collect()
+    failures += check('connector alive while a view remains', conn_ref() is not None)
+    del elecs
+    gc.collect()
+    failures += check('connector released with its last view', conn_ref() is None)
+    return failures
+
+def check_exports(siqadconn, problem, result):
+    failures = 0
+    conn = siqadconn.SiQADConnector('check_python_buffers', problem, result)
+    ints = array('i', [1, 2, 3])
+    failures += check('int buffers are not float buffers',
+            not conn._isFloatBuffer(ints) and not conn._isFloatBuffer(b'abc'))
+    failures += check('typed export rejects int buffers',
+            raises(TypeError, conn._setExportBuffer, 'potential', ints))
+    failures += check('typed export rejects int8 buffers',
+            raises(TypeError, conn._setExportBuffer, 'potential', array('b', [1, 2, 3])))
+    failures += check('typed export rejects non-buffers',
+            raises(TypeError, conn._setExportBuffer, 'potential', [1., 2., 3.]))
+    db_loc = memoryview(array('f', [0.5, 1.5])).cast('B').cast('f', (1, 2))
+    conn.export(db_loc=db_loc)
+    try:
+        import numpy as np
+        have_numpy = True
+    except ImportError:
+        have_numpy = False
+        print('SKIP: export() of NumPy int arrays, NumPy not available')
+    if have_numpy:
+        # int arrays take the string path and are written as the integers
+        conn.export(potential=np.array([[1, 2, 3], [4, 5, 6]], dtype=np.int32))
+    del conn
+    gc.collect()
+    with open(result) as f:
+        written = f.read()
+    failures += check('export() writes float32 buffers through the typed path',
+            '<dbdot x="0.5" y="1.5"/>' in written)
+    if have_numpy:
+        failures += check('export() writes int arrays by value',
+                '<potential_val x="4" y="5" val="6"/>' in written)
+    return failures
+
+if __name__ == '__main__':
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('module_dir', help='Directory holding the built siqadconn module.')
+    parser.add_argument('work_dir', help='Directory for problem and result files.')
+    args = parser.parse_args()
+
+    sys.path.insert(0, os.path.abspath(args.module_dir))
+    sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'bench'))
+    import siqadconn
+    from gen_problem import write_problem
+
+    problem = os.path.join(args.work_dir, 'buffers_problem.xml')
+    with open(problem, 'w') as f:
+        write_problem(f, 10, 3)
+    failures = check_views(siqadconn, problem, os.path.join(args.work_dir, 'buffers_views.xml'))
+    failures += check_exports(siqadconn, problem, os.path.join(args.work_dir, 'buffers_exports.xml'))
+    sys.exit(1 if failures else 0)
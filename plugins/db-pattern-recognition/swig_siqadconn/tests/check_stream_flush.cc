@@ -0,0 +1,73 @@
+// @file:     check_stream_flush.cc
+// @license:  Apache License 2.0
+//
+// @desc:     Check that streamed results reach the result file within the
+//            flush interval even when nothing else is appended afterwards.
+
+#include "siqadconn.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// problem file with a single DB, enough to construct a connector
+static const char *problem_xml =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<siqad>\n"
+  "  <sim_params><num_threads>1</num_threads></sim_params>\n"
+  "  <layers><layer_prop><name>Surface</name><type>DB</type>"
+  "<zoffset>0</zoffset><zheight>0</zheight></layer_prop></layers>\n"
+  "  <design><layer type=\"DB\"><dbdot><layer_id>2</layer_id>"
+  "<latcoord n=\"0\" m=\"0\" l=\"0\"/><physloc x=\"0\" y=\"0\"/></dbdot>"
+  "</layer></design>\n</siqad>\n";
+
+static std::string readFile(const std::string &path)
+{
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// append a single result through append, then wait for longer than the flush
+// interval and check that the given text is in the result file
+template <typename Append>
+static int check(const std::string &problem_path, const std::string &result_path,
+    const std::string &name, const std::string &expected, Append append)
+{
+  phys::SiQADConnector conn("check_stream_flush", problem_path, result_path);
+  conn.setLogLevel(phys::LogSilent);
+  // a first append flushes right away as no flush has happened yet, the
+  // second one is left to the flusher
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  append(conn, 0);
+  append(conn, 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+
+  bool flushed = readFile(result_path).find(expected) != std::string::npos;
+  std::cout << (flushed ? "PASS: " : "FAIL: ") << name
+            << " flushed without further appends" << std::endl;
+  return flushed ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : ".";
+  std::string problem_path = dir + "/flush_problem.xml";
+  std::ofstream(problem_path) << problem_xml;
+
+  int failures = check(problem_path, dir + "/flush_potentials.xml", "potential_map",
+      "val=\"1.5\"", [](phys::SiQADConnector &conn, int i) {
+        double row[3] = {0, 0, 0.5 + i};
+        conn.appendPotentials(row, 1);
+      });
+  failures += check(problem_path, dir + "/flush_charges.xml", "elec_dist",
+      "energy=\"-2\"", [](phys::SiQADConnector &conn, int i) {
+        int8_t charge = -1;
+        conn.appendDBCharge(&charge, 1, -1. - i);
+      });
+  return failures ? 1 : 0;
+}
@@ -205,10 +205,10 @@ void gui::ApplicationGUI::initGUI()
           sim_visualize, &gui::SimVisualizer::showJob);
 
   // widget-app gui signals
-  connect(job_manager, &gui::JobManager::sig_exportJobProblem,
-          [this](comp::JobStep *js, gui::DesignInclusionArea inclusion_area)
+  connect(job_manager, &gui::JobManager::sig_exportJobProblems,
+          [this](comp::SimJob *job, gui::DesignInclusionArea inclusion_area)
           {
-            saveToFile(SaveSimulationProblem, js->problemPath(), inclusion_area, js);
+            job->exportProblems(design_pan->designSnapshot(inclusion_area));
           });
   connect(settings_dialog, &settings::SettingsDialog::sig_resetSettings,
           [this](){reset_settings = true;});
@@ -50,6 +50,10 @@ void ECS::readFromXMLStream(QXmlStreamReader *rs)
       }
 
       QString dist = rs->readElementText();
+      if (rs->hasError()) {
+        // discard configs cut off by a truncated result file
+        break;
+      }
 
       // convert string distribution to array of int
       int neg_charge;
@@ -90,6 +94,10 @@ void ECS::readFromXMLStream(QXmlStreamReader *rs)
     }
   }
 
+  // configs from previously read sections are sorted along with the new ones
+  charge_configs_read.append(charge_configs.values());
+  charge_configs.clear();
+
   // sort by energy
   std::sort(charge_configs_read.begin(), charge_configs_read.end(),
             [](const ChargeConfig &a, const ChargeConfig &b) -> bool
@@ -106,7 +114,8 @@ void ECS::readFromXMLStream(QXmlStreamReader *rs)
   // there are more ways to visualize electron config sets (e.g. scatter plot
   // or histogram) the pre-processing have to be optimized accordingly.
 
-  // TODO consider adding deduplication support to SiQADConn
+  // duplicate configs are merged by SiQADConn for plugins that accumulate
+  // them with SiQADConnector::accumulateDBCharge
 }
 
 QList<ECS::ChargeConfig> ECS::degenerateConfigs(const ECS::ChargeConfig &t_config) const
@@ -60,7 +60,8 @@ namespace comp{
     //! Destructor.
     ~ChargeConfigSet() {};
 
-    //! Read charge config sets from XML stream.
+    //! Read charge config sets from XML stream. Configs are merged with any
+    //! previously read ones.
     void readFromXMLStream(QXmlStreamReader *rs);
 
     //! Return whether this config set is empty.
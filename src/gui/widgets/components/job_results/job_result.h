@@ -26,6 +26,7 @@ namespace comp{
     //! The result type of this job result set.
     enum ResultType{UndefinedResult, DBLocationsResult, ChargeConfigsResult, 
       PotentialLandscapeResult, SQCommandsResult};
+    Q_ENUM(ResultType);
     
     //! Constructor.
     JobResult(ResultType result_type=UndefinedResult);
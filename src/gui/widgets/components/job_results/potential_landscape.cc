@@ -12,6 +12,25 @@ using namespace comp;
 
 PotentialLandscape::PotentialLandscape(QXmlStreamReader *rs, const QString &result_dir_path)
   : JobResult(PotentialLandscapeResult)
+{
+  readFromXMLStream(rs);
+
+  // hacky way to get image/animation paths
+  // TODO future proper implementation should have PoisSolver pass paths through
+  // SiQADConn
+  QDir result_dir(result_dir_path);
+  QString static_plot_file_name = "SiAirBoundary000.png";
+  QString animation_file_name = "SiAirBoundary.gif";
+  QString plot_legend_file_name = "SiAirPlot.png";
+  if (result_dir.exists(static_plot_file_name))
+    static_plot_path = result_dir.absoluteFilePath(static_plot_file_name);
+  if (result_dir.exists(animation_file_name))
+    animation_path = result_dir.absoluteFilePath(animation_file_name);
+  if (result_dir.exists(plot_legend_file_name))
+    plot_legend_path = result_dir.absoluteFilePath(plot_legend_file_name);
+}
+
+void PotentialLandscape::readFromXMLStream(QXmlStreamReader *rs)
 {
   auto unrecognizedXMLElement = [](QXmlStreamReader &rs)
   {
@@ -33,18 +52,4 @@ PotentialLandscape::PotentialLandscape(QXmlStreamReader *rs, const QString &resu
       unrecognizedXMLElement(*rs);
     }
   }
-
-  // hacky way to get image/animation paths
-  // TODO future proper implementation should have PoisSolver pass paths through
-  // SiQADConn
-  QDir result_dir(result_dir_path);
-  QString static_plot_file_name = "SiAirBoundary000.png";
-  QString animation_file_name = "SiAirBoundary.gif";
-  QString plot_legend_file_name = "SiAirPlot.png";
-  if (result_dir.exists(static_plot_file_name))
-    static_plot_path = result_dir.absoluteFilePath(static_plot_file_name);
-  if (result_dir.exists(animation_file_name))
-    animation_path = result_dir.absoluteFilePath(animation_file_name);
-  if (result_dir.exists(plot_legend_file_name))
-    plot_legend_path = result_dir.absoluteFilePath(plot_legend_file_name);
 }
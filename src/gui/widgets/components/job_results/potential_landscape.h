@@ -33,6 +33,9 @@ namespace comp{
     //! Destructor.
     ~PotentialLandscape() {};
 
+    //! Read potentials from XML stream, appending them to previously read ones.
+    void readFromXMLStream(QXmlStreamReader *rs);
+
     //! Return a list of vector of potentials (TODO change to struct).
     //! TODO add z-height specification
     QList<QVector<float>> potentials() const {return potential_vals;}
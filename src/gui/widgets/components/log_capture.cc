@@ -0,0 +1,109 @@
+// @file:     log_capture.cc
+// @author:   Samuel
+// @created:  2019.05.06
+// @license:  GNU LGPL v3
+//
+// @desc:     LogCapture implementation.
+
+#include "log_capture.h"
+#include "settings/settings.h"
+
+using namespace comp;
+
+const int LogCapture::buffer_bytes;
+const qint64 LogCapture::page_bytes;
+
+LogCapture::LogCapture(const QString &file_path)
+  : file_path(file_path), log_file(file_path)
+{
+  max_file_bytes = qMax(1, settings::AppSettings::instance()->get<int>("plugs/max_log_mb"))
+    * qint64(1024*1024);
+}
+
+LogCapture::~LogCapture()
+{
+  flush();
+}
+
+void LogCapture::append(const QByteArray &data)
+{
+  buffer.append(data);
+  if (buffer.size() >= buffer_bytes)
+    flush();
+}
+
+void LogCapture::flush()
+{
+  if (buffer.isEmpty())
+    return;
+
+  if (!log_file.isOpen() && !log_file.open(QFile::WriteOnly | QFile::Truncate)) {
+    // drop the output rather than letting the buffer grow without bound
+    qWarning() << QObject::tr("Failed to open log file %1").arg(file_path);
+    buffer.clear();
+    return;
+  }
+  log_file.write(buffer);
+  log_file.flush();
+  buffer.clear();
+
+  if (log_file.size() > max_file_bytes)
+    rotate();
+}
+
+void LogCapture::rotate()
+{
+  log_file.close();
+  QString rotated_path = file_path + ".1";
+  QFile::remove(rotated_path);
+  QFile::rename(file_path, rotated_path);
+  if (!log_file.open(QFile::WriteOnly | QFile::Truncate))
+    qWarning() << QObject::tr("Failed to open log file %1").arg(file_path);
+}
+
+QStringList LogCapture::filePaths() const
+{
+  QStringList paths;
+  for (const QString &path : QStringList({file_path + ".1", file_path}))
+    if (QFileInfo::exists(path))
+      paths.append(path);
+  return paths;
+}
+
+int LogCapture::pageCount()
+{
+  flush();
+  int count = 0;
+  for (const QString &path : filePaths())
+    count += (QFileInfo(path).size() + page_bytes - 1) / page_bytes;
+  return count;
+}
+
+QString LogCapture::page(int i)
+{
+  flush();
+  for (const QString &path : filePaths()) {
+    qint64 size = QFileInfo(path).size();
+    int file_pages = (size + page_bytes - 1) / page_bytes;
+    if (i >= file_pages) {
+      i -= file_pages;
+      continue;
+    }
+
+    // map only the requested page of the log file
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+      return QString();
+    qint64 offset = i * page_bytes;
+    qint64 len = qMin(page_bytes, size - offset);
+    uchar *mem = file.map(offset, len);
+    if (mem == nullptr) {
+      file.seek(offset);
+      return QString::fromUtf8(file.read(len));
+    }
+    QString text = QString::fromUtf8(reinterpret_cast<const char*>(mem), len);
+    file.unmap(mem);
+    return text;
+  }
+  return QString();
+}
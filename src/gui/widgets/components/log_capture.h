@@ -0,0 +1,69 @@
+// @file:     log_capture.h
+// @author:   Samuel
+// @created:  2019.05.06
+// @license:  GNU LGPL v3
+//
+// @desc:     Bounded capture of plugin terminal output to rotating log files.
+
+#ifndef _COMP_LOG_CAPTURE_H_
+#define _COMP_LOG_CAPTURE_H_
+
+#include <QtCore>
+
+namespace comp{
+
+  //! Captures one terminal output channel of a plugin process. Output is
+  //! collected in a fixed-size memory buffer which spills to a log file once
+  //! full, and the log file is rotated to "<file_path>.1" when it exceeds the
+  //! plugs/max_log_mb setting. The captured output is read back page by page
+  //! from the log files so that it never has to be held in memory as a whole.
+  class LogCapture
+  {
+  public:
+
+    //! Constructor taking the log file path. The file is only created (and
+    //! truncated) on the first append, so a capture of an existing log file
+    //! can be used to page through it.
+    LogCapture(const QString &file_path);
+
+    //! Destructor, spills buffered output.
+    ~LogCapture();
+
+    //! Append output to the capture.
+    void append(const QByteArray &data);
+
+    //! Write buffered output to the log file.
+    void flush();
+
+    //! Return the path of the current log file.
+    QString filePath() const {return file_path;}
+
+    //! Return the existing log files, oldest first.
+    QStringList filePaths() const;
+
+    //! Return the number of pages of captured output.
+    int pageCount();
+
+    //! Return the captured output on page i, pages hold page_bytes bytes.
+    QString page(int i);
+
+    //! Bytes of output held in memory before spilling to the log file.
+    static const int buffer_bytes = 256*1024;
+
+    //! Bytes of output on each page.
+    static const qint64 page_bytes = 256*1024;
+
+  private:
+
+    //! Rotate the current log file to "<file_path>.1".
+    void rotate();
+
+    QString file_path;        // current log file path
+    QFile log_file;           // current log file, opened on the first spill
+    QByteArray buffer;        // output not yet spilled to the log file
+    qint64 max_file_bytes;    // rotate the log file beyond this size
+  };
+
+} // end of comp namespace
+
+#endif
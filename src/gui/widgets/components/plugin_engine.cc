@@ -72,6 +72,8 @@ PluginEngine::PluginEngine(const QString &desc_file_path, QWidget *parent)
     } else if (rs.name() == "venv_use_system_site_packages") {
       // introduced in SiQAD v0.2.2
       venv_use_system_site = rs.readElementText() == "1";
+    } else if (rs.name() == "core_weight") {
+      core_weight = qMax(1, rs.readElementText().toInt());
     } else if (rs.name() == "dep_path") {
       // TODO perform path replacement instead
       dep_path = QDir(plugin_root_path).absoluteFilePath(rs.readElementText());
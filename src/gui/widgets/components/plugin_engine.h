@@ -151,6 +151,10 @@ namespace comp{
     //! to be ready.
     bool readyToUse() {return ready_to_use;}
 
+    //! Return the number of cores that a job step of this plugin is expected 
+    //! to occupy, used by JobManager to budget concurrent jobs.
+    int coreWeight() const {return core_weight;}
+
 
   private:
 
@@ -174,6 +178,7 @@ namespace comp{
     QString dep_path;             // dependencies path
     QString desc_file_path;       // description file path (normally *.sqplug)
     QString preset_dir_path;      // user configuration directory path
+    int core_weight=1;            // cores occupied by one running job step
 
     bool ready_to_use;            // holds whether the plugin is ready to use
     bool venv_init_success;       // holds whether venv initialization was successful
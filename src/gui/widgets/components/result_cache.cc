@@ -0,0 +1,212 @@
+// @file:     result_cache.cc
+// @author:   Samuel
+// @created:  2019.05.02
+// @license:  GNU LGPL v3
+//
+// @desc:     ResultCache implementation.
+
+#include <QXmlStreamReader>
+#include <algorithm>
+#include "result_cache.h"
+#include "settings/settings.h"
+
+using namespace comp;
+
+// copy files under src_dir to the same relative paths under dst_dir, skipping
+// the absolute paths in exclude
+static bool copyDirFiles(const QDir &src_dir, const QDir &dst_dir,
+    const QStringList &exclude=QStringList())
+{
+  QDirIterator it(src_dir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    QString src_path = it.next();
+    if (exclude.contains(QFileInfo(src_path).absoluteFilePath()))
+      continue;
+    QString dst_path = dst_dir.absoluteFilePath(src_dir.relativeFilePath(src_path));
+    QDir().mkpath(QFileInfo(dst_path).absolutePath());
+    QFile::remove(dst_path);
+    if (!QFile::copy(src_path, dst_path))
+      return false;
+  }
+  return true;
+}
+
+ResultCache *ResultCache::instance()
+{
+  static ResultCache cache;
+  return &cache;
+}
+
+bool ResultCache::loadSettings()
+{
+  settings::AppSettings *app_settings = settings::AppSettings::instance();
+  QDir tmp_root(app_settings->getPath("plugs/runtime_tmp_root_path"));
+  QMutexLocker locker(&mutex);
+  root_path = tmp_root.absoluteFilePath("result_cache");
+  max_bytes = app_settings->get<qint64>("plugs/result_cache_max_mb") * 1024 * 1024;
+  return max_bytes > 0;
+}
+
+QString ResultCache::cacheKey(const QString &problem_path, const QString &engine_id,
+    const QStringList &command_format, const QMap<QString, QString> &job_params)
+{
+  QFile problem_file(problem_path);
+  if (!problem_file.open(QFile::ReadOnly | QFile::Text))
+    return QString();
+
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  auto addField = [&hash](const QString &field)
+  {
+    hash.addData(field.toUtf8());
+    hash.addData("\0", 1);
+  };
+
+  addField(engine_id);
+  addField(command_format.join("\n"));
+  for (const QString &key : job_params.keys()) {
+    addField(key);
+    addField(job_params.value(key));
+  }
+
+  // hash the problem as a stream of elements, attributes and trimmed text so
+  // that formatting and the program section (save date and version) don't
+  // affect the key
+  QXmlStreamReader rs(&problem_file);
+  while (!rs.atEnd()) {
+    rs.readNext();
+    if (rs.isStartElement()) {
+      if (rs.name() == "program") {
+        rs.skipCurrentElement();
+        continue;
+      }
+      addField("<" + rs.name().toString());
+      for (const QXmlStreamAttribute &attr : rs.attributes()) {
+        addField(attr.name().toString());
+        addField(attr.value().toString());
+      }
+    } else if (rs.isEndElement()) {
+      addField(">");
+    } else if (rs.isCharacters() && !rs.isWhitespace()) {
+      addField(rs.text().toString().trimmed());
+    }
+  }
+  if (rs.hasError())
+    return QString();
+
+  return QString::fromLatin1(hash.result().toHex());
+}
+
+bool ResultCache::restore(const QString &key, const QString &step_dir_path,
+    const QString &result_path)
+{
+  QMutexLocker locker(&mutex);
+  QDir entry_dir(cacheDir().absoluteFilePath(key));
+  if (key.isEmpty() || !entry_dir.exists("sim_result.xml")) {
+    miss_count++;
+    return false;
+  }
+
+  QFile::remove(result_path);
+  if (!QFile::copy(entry_dir.absoluteFilePath("sim_result.xml"), result_path)
+      || !copyDirFiles(QDir(entry_dir.absoluteFilePath("files")), QDir(step_dir_path))) {
+    qWarning() << QObject::tr("Failed to restore cached result %1").arg(key);
+    miss_count++;
+    return false;
+  }
+
+  // mark the entry as recently used
+  QFile stamp_file(entry_dir.absoluteFilePath("last_used"));
+  if (stamp_file.open(QFile::WriteOnly | QFile::Truncate))
+    stamp_file.write(QByteArray::number(QDateTime::currentMSecsSinceEpoch()));
+
+  hit_count++;
+  return true;
+}
+
+void ResultCache::store(const QString &key, const QString &step_dir_path,
+    const QString &result_path, const QString &problem_path)
+{
+  QMutexLocker locker(&mutex);
+  if (key.isEmpty() || max_bytes <= 0)
+    return;
+
+  // write the entry under a temporary name so that partial entries are never
+  // restored
+  QDir cache_dir = cacheDir();
+  QDir tmp_dir(cache_dir.absoluteFilePath(key + ".tmp"));
+  tmp_dir.removeRecursively();
+  tmp_dir.mkpath(".");
+
+  bool ok = QFile::copy(result_path, tmp_dir.absoluteFilePath("sim_result.xml"));
+  QStringList exclude({QFileInfo(problem_path).absoluteFilePath(),
+      QFileInfo(result_path).absoluteFilePath()});
+  ok = ok && copyDirFiles(QDir(step_dir_path), QDir(tmp_dir.absoluteFilePath("files")), exclude);
+
+  QFile stamp_file(tmp_dir.absoluteFilePath("last_used"));
+  ok = ok && stamp_file.open(QFile::WriteOnly);
+  if (ok) {
+    stamp_file.write(QByteArray::number(QDateTime::currentMSecsSinceEpoch()));
+    stamp_file.close();
+  }
+
+  QDir(cache_dir.absoluteFilePath(key)).removeRecursively();
+  if (!ok || !cache_dir.rename(key + ".tmp", key)) {
+    qWarning() << QObject::tr("Failed to store result in cache %1").arg(key);
+    tmp_dir.removeRecursively();
+    return;
+  }
+
+  evict(max_bytes);
+}
+
+void ResultCache::clear()
+{
+  loadSettings();
+  QMutexLocker locker(&mutex);
+  cacheDir().removeRecursively();
+}
+
+QDir ResultCache::cacheDir() const
+{
+  QDir cache_dir(root_path);
+  cache_dir.mkpath(".");
+  return cache_dir;
+}
+
+void ResultCache::evict(qint64 max_bytes)
+{
+  struct Entry
+  {
+    QString path;
+    qint64 last_used;
+    qint64 size;
+  };
+
+  QList<Entry> entries;
+  qint64 total_size = 0;
+  QDir cache_dir = cacheDir();
+  for (const QFileInfo &entry_info : cache_dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    Entry entry;
+    entry.path = entry_info.absoluteFilePath();
+    entry.size = 0;
+    QDirIterator it(entry.path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+      it.next();
+      entry.size += it.fileInfo().size();
+    }
+    QFile stamp_file(QDir(entry.path).absoluteFilePath("last_used"));
+    entry.last_used = stamp_file.open(QFile::ReadOnly) ? stamp_file.readAll().toLongLong() : 0;
+    total_size += entry.size;
+    entries.append(entry);
+  }
+
+  std::sort(entries.begin(), entries.end(),
+      [](const Entry &a, const Entry &b) {return a.last_used < b.last_used;});
+  for (const Entry &entry : entries) {
+    if (total_size <= max_bytes)
+      break;
+    qDebug() << QObject::tr("Evicting cached result %1").arg(entry.path);
+    QDir(entry.path).removeRecursively();
+    total_size -= entry.size;
+  }
+}
@@ -0,0 +1,80 @@
+// @file:     result_cache.h
+// @author:   Samuel
+// @created:  2019.05.02
+// @license:  GNU LGPL v3
+//
+// @desc:     On-disk cache of job step results keyed on the problem, the
+//            plugin engine and the job parameters.
+
+#ifndef _COMP_RESULT_CACHE_H_
+#define _COMP_RESULT_CACHE_H_
+
+#include <QtCore>
+
+namespace comp{
+
+  //! Least recently used cache of job step results stored under the plugin
+  //! runtime temp directory. Each entry is a directory named after the cache
+  //! key holding the result file and the other files the step produced,
+  //! including its terminal output logs. Settings are read on the GUI thread
+  //! by loadSettings(), restore() and store() may then be called from worker
+  //! threads and are serialized against each other.
+  class ResultCache
+  {
+  public:
+
+    //! Return the application-wide result cache.
+    static ResultCache *instance();
+
+    //! Read the cache location and size cap from the settings and return
+    //! whether caching is enabled (plugs/result_cache_max_mb > 0). Call from
+    //! the GUI thread before handing work to the worker threads.
+    bool loadSettings();
+
+    //! Compute the cache key of a job step from the canonicalized problem
+    //! file, the identity of the engine and the job parameters. Returns an
+    //! empty string if the problem file can't be read.
+    static QString cacheKey(const QString &problem_path, const QString &engine_id,
+        const QStringList &command_format, const QMap<QString, QString> &job_params);
+
+    //! Materialize the cached result of key at result_path and its other
+    //! files in step_dir_path. Returns whether the key was found.
+    bool restore(const QString &key, const QString &step_dir_path,
+        const QString &result_path);
+
+    //! Store the result at result_path along with the other files in
+    //! step_dir_path except for problem_path, then evict least recently used
+    //! entries until the cache fits in its size cap.
+    void store(const QString &key, const QString &step_dir_path,
+        const QString &result_path, const QString &problem_path);
+
+    //! Remove all cache entries.
+    void clear();
+
+    //! Return the number of cache hits in this session.
+    int hits() const {return hit_count.load();}
+
+    //! Return the number of cache misses in this session.
+    int misses() const {return miss_count.load();}
+
+  private:
+
+    //! Private constructor, use instance().
+    ResultCache() {};
+
+    //! Return the cache root directory.
+    QDir cacheDir() const;
+
+    //! Evict least recently used entries until the total size fits max_bytes.
+    void evict(qint64 max_bytes);
+
+    QMutex mutex;             // serializes access to the cache entries and settings
+    QString root_path;        // cache root directory from the last loadSettings()
+    qint64 max_bytes=0;       // size cap from the last loadSettings()
+    QAtomicInt hit_count;     // cache hits in this session
+    QAtomicInt miss_count;    // cache misses in this session
+  };
+
+} // end of comp namespace
+
+#endif
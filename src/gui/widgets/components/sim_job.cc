@@ -10,11 +10,341 @@
 #include <QProcess>
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <streambuf>
+#include <ctime>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "sim_job.h"
 #include "../../../global.h"
 
 using namespace comp;
 
+// Parses the result file of a job step on a QThreadPool thread and hands the
+// results back to the job step's thread through a queued call. Used when the
+// process exits and when results are loaded on demand.
+class comp::ResultParseTask : public QRunnable
+{
+public:
+  ResultParseTask(JobStep *js, SimJob *archive_job=nullptr)
+    : js(js), archive_job(archive_job), result_path(js->resultPath()),
+      target_thread(js->thread())
+  {
+    if (archive_job != nullptr)
+      archive_paths = QStringList({js->jobStepTempDirPath(), js->problemPath(),
+          js->resultPath()});
+  }
+
+  void run() override
+  {
+    // files of steps imported from an archive are decompressed first
+    for (const QString &path : archive_paths)
+      archive_job->extractFromArchive(path);
+    JobStep::ParsedResults parsed = JobStep::parseResultFile(result_path);
+    for (JobResult *result : parsed.job_results)
+      result->moveToThread(target_thread);
+    js->pending_results = parsed;
+    QMetaObject::invokeMethod(js, "resultsParsed", Qt::QueuedConnection);
+    js->parse_done.release();
+  }
+
+private:
+  JobStep *js;
+  SimJob *archive_job;
+  QStringList archive_paths;
+  QString result_path;
+  QThread *target_thread;
+};
+
+// Computes the result cache key of a job step and tries to restore its result
+// on a QThreadPool thread, the outcome is handed back to the job step's thread
+// through a queued call.
+class comp::CacheLookupTask : public QRunnable
+{
+public:
+  CacheLookupTask(JobStep *js, const QString &engine_id)
+    : js(js), engine_id(engine_id), problem_path(js->problemPath()),
+      command_format(js->command_format), job_params(js->jobParameters()),
+      step_dir_path(js->jobStepTempDirPath()), result_path(js->resultPath()) {}
+
+  void run() override
+  {
+    QString key = ResultCache::cacheKey(problem_path, engine_id, command_format,
+        job_params);
+    bool restored = ResultCache::instance()->restore(key, step_dir_path,
+        result_path);
+    QMetaObject::invokeMethod(js, "cacheLookedUp", Qt::QueuedConnection,
+                              Q_ARG(QString, key), Q_ARG(bool, restored));
+    js->cache_done.release();
+  }
+
+private:
+  JobStep *js;
+  QString engine_id;
+  QString problem_path;
+  QStringList command_format;
+  QMap<QString, QString> job_params;
+  QString step_dir_path;
+  QString result_path;
+};
+
+// Stores the result of a job step in the result cache on a QThreadPool 
+// thread. Nothing is handed back so the task only holds copies of the paths.
+class comp::CacheStoreTask : public QRunnable
+{
+public:
+  CacheStoreTask(const QString &key, const QString &step_dir_path,
+                 const QString &result_path, const QString &problem_path)
+    : key(key), step_dir_path(step_dir_path), result_path(result_path),
+      problem_path(problem_path) {}
+
+  void run() override
+  {
+    ResultCache::instance()->store(key, step_dir_path, result_path, problem_path);
+  }
+
+private:
+  QString key;
+  QString step_dir_path;
+  QString result_path;
+  QString problem_path;
+};
+
+// Writes the problem files of a job on a QThreadPool thread. The design is
+// serialized once on the GUI thread beforehand, each problem file is the
+// program flags and sim_params of its step around that snapshot.
+class comp::ProblemExportTask : public QRunnable
+{
+public:
+  ProblemExportTask(SimJob *job, const QList<JobStep*> &job_steps,
+                    const QByteArray &design_snapshot)
+    : job(job), design_snapshot(design_snapshot),
+      version(QCoreApplication::applicationVersion())
+  {
+    for (JobStep *js : job_steps)
+      problems.append(qMakePair(js->problemPath(), js->jobParameters()));
+  }
+
+  void run() override
+  {
+    bool ok = true;
+    QMap<QByteArray, QString> written;  // sim_params XML mapped to problem path
+    for (const auto &problem : problems) {
+      QByteArray params_xml = simParamsXml(problem.second);
+      if (written.contains(params_xml)) {
+        ok = ok && linkProblem(written.value(params_xml), problem.first);
+      } else {
+        ok = ok && writeProblem(problem.first, params_xml);
+        written.insert(params_xml, problem.first);
+      }
+    }
+    QMetaObject::invokeMethod(job, "problemsExported", Qt::QueuedConnection,
+                              Q_ARG(bool, ok));
+    job->export_done.release();
+  }
+
+private:
+  // sim_params element of the given job parameters
+  QByteArray simParamsXml(const QMap<QString, QString> &job_params)
+  {
+    QByteArray xml;
+    QBuffer buf(&xml);
+    buf.open(QBuffer::WriteOnly);
+    QXmlStreamWriter ws(&buf);
+    ws.setAutoFormatting(true);
+    ws.writeStartElement("sim_params");
+    for (const QString &key : job_params.keys())
+      ws.writeTextElement(key, job_params.value(key));
+    ws.writeEndElement();
+    return xml;
+  }
+
+  // write the problem file at path, same layout as ApplicationGUI::saveToFile
+  bool writeProblem(const QString &path, const QByteArray &params_xml)
+  {
+    QByteArray header;
+    QBuffer buf(&header);
+    buf.open(QBuffer::WriteOnly);
+    QXmlStreamWriter ws(&buf);
+    ws.setAutoFormatting(true);
+    ws.writeComment("Program Flags");
+    ws.writeStartElement("program");
+    ws.writeTextElement("file_purpose", "simulation");
+    ws.writeTextElement("version", version);
+    ws.writeTextElement("date", QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss"));
+    ws.writeEndElement();
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+      qWarning() << QObject::tr("Failed to write problem file %1: %2")
+        .arg(path).arg(file.errorString());
+      return false;
+    }
+    file.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<siqad>");
+    file.write(header);
+    file.write(params_xml);
+    file.write(design_snapshot);
+    file.write("\n</siqad>\n");
+    return file.error() == QFileDevice::NoError;
+  }
+
+  // hard link the identical problem file at src_path to dst_path, falling 
+  // back to a copy where hard links aren't available
+  bool linkProblem(const QString &src_path, const QString &dst_path)
+  {
+    QFile::remove(dst_path);
+#ifndef _WIN32
+    if (::link(QFile::encodeName(src_path).constData(),
+               QFile::encodeName(dst_path).constData()) == 0)
+      return true;
+#endif
+    return QFile::copy(src_path, dst_path);
+  }
+
+  SimJob *job;
+  QByteArray design_snapshot;
+  QString version;
+  QList<QPair<QString, QMap<QString, QString>>> problems;  // problem path and job params of each step
+};
+
+// Stream buffer reading a file in chunks for the archiver, reporting the 
+// bytes read and ending the stream early once on_read returns false.
+class ArchiveFileBuf : public std::streambuf
+{
+public:
+  ArchiveFileBuf(QFile *file, std::function<bool(qint64)> on_read)
+    : file(file), on_read(on_read) {}
+
+protected:
+  int_type underflow() override
+  {
+    qint64 len = file->read(buf, sizeof(buf));
+    if (len <= 0 || !on_read(len))
+      return traits_type::eof();
+    setg(buf, buf, buf + len);
+    return traits_type::to_int_type(buf[0]);
+  }
+
+  // the archiver seeks to the end to check whether the file needs zip64
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode) override
+  {
+    qint64 base = (dir == std::ios_base::beg) ? 0
+      : ((dir == std::ios_base::end) ? file->size() : file->pos() - (egptr() - gptr()));
+    return seekpos(base + off, std::ios_base::in);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode) override
+  {
+    if (!file->seek(pos))
+      return pos_type(off_type(-1));
+    setg(buf, buf, buf);
+    return pos;
+  }
+
+private:
+  QFile *file;
+  std::function<bool(qint64)> on_read;
+  char buf[64*1024];
+};
+
+// Writes the job directory into a job archive on a QThreadPool thread, one 
+// file at a time, posting the progress back to the job.
+class comp::JobExportTask : public QRunnable
+{
+public:
+  JobExportTask(SimJob *job, const QString &job_dir_path, const QString &out_path)
+    : job(job), out_path(out_path)
+  {
+    // archive entries are named relative to the parent of the job directory
+    QDir job_dir(job_dir_path);
+    QDir parent_dir = job_dir;
+    parent_dir.cdUp();
+    QDirIterator it(job_dir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+      it.next();
+      files.append(qMakePair(it.filePath(), parent_dir.relativeFilePath(it.filePath())));
+      total_bytes += it.fileInfo().size();
+    }
+  }
+
+  void run() override
+  {
+    bool ok = true;
+    try {
+      ok = writeArchive();
+    } catch (const std::exception &e) {
+      qWarning() << QObject::tr("Error when writing archive %1: %2").arg(out_path).arg(e.what());
+      ok = false;
+    }
+    if (!ok)
+      QFile::remove(out_path);
+    QMetaObject::invokeMethod(job, "jobExportFinished", Qt::QueuedConnection,
+                              Q_ARG(bool, ok));
+    job->job_export_done.release();
+  }
+
+private:
+  bool writeArchive()
+  {
+    // already compressed plots and archives are stored as they are
+    static const QStringList stored_suffixes({"png", "gif", "jpg", "jpeg", "zip", "gz"});
+
+    QFile::remove(out_path);
+    zipper::Zipper zipper(out_path.toStdString());
+    qint64 done_bytes = 0;
+    int percent = 0;
+    auto onRead = [this, &done_bytes, &percent](qint64 len)
+    {
+      done_bytes += len;
+      int new_percent = total_bytes > 0 ? int(100 * done_bytes / total_bytes) : 100;
+      if (new_percent != percent) {
+        percent = new_percent;
+        QMetaObject::invokeMethod(job, "jobExportProgressed", Qt::QueuedConnection,
+                                  Q_ARG(int, percent));
+      }
+      return job->job_export_cancelled.loadAcquire() == 0;
+    };
+
+    bool ok = true;
+    for (const auto &file_entry : files) {
+      QFile file(file_entry.first);
+      if (!file.open(QFile::ReadOnly)) {
+        qWarning() << QObject::tr("Failed to read %1 for export").arg(file_entry.first);
+        ok = false;
+        break;
+      }
+      QDateTime mtime = QFileInfo(file).lastModified();
+      std::tm timestamp = std::tm();
+      timestamp.tm_year = mtime.date().year() - 1900;
+      timestamp.tm_mon = mtime.date().month() - 1;
+      timestamp.tm_mday = mtime.date().day();
+      timestamp.tm_hour = mtime.time().hour();
+      timestamp.tm_min = mtime.time().minute();
+      timestamp.tm_sec = mtime.time().second();
+
+      ArchiveFileBuf file_buf(&file, onRead);
+      std::istream input(&file_buf);
+      zipper::Zipper::zipFlags flags =
+        stored_suffixes.contains(QFileInfo(file).suffix().toLower())
+        ? zipper::Zipper::Store : zipper::Zipper::Better;
+      ok = zipper.add(input, timestamp, file_entry.second.toStdString(), flags);
+      if (!ok || job->job_export_cancelled.loadAcquire() != 0) {
+        ok = false;
+        break;
+      }
+    }
+    zipper.close();
+    return ok;
+  }
+
+  SimJob *job;
+  QString out_path;
+  QList<QPair<QString, QString>> files;   // file path and archive entry name of each file
+  qint64 total_bytes=0;
+};
+
 // JobStep implementation
 JobStep::JobStep(PluginEngine *t_engine, QStringList t_command_format,
                  gui::PropertyMap t_job_prop_map)
@@ -38,6 +368,36 @@ JobStep::JobStep(QXmlStreamReader *rs, QDir job_root_dir)
     } else if (rs->name() == "command") {
       // TODO implement
       rs->skipCurrentElement();
+    } else if (rs->name() == "dependencies") {
+      while (rs->readNextStartElement())
+        step_deps.append(rs->readElementText().toInt());
+      deps_declared = true;
+    } else if (rs->name() == "job_params") {
+      while (rs->readNextStartElement()) {
+        QString key = rs->attributes().value("key").toString();
+        job_params.insert(key, rs->readElementText());
+      }
+    } else if (rs->name() == "result_types") {
+      auto&& meta_enum = QMetaEnum::fromType<comp::JobResult::ResultType>();
+      while (rs->readNextStartElement())
+        result_types.append(static_cast<comp::JobResult::ResultType>(
+              meta_enum.keyToValue(rs->readElementText().toLocal8Bit())));
+      result_types_known = true;
+    } else if (rs->name() == "resource_usage") {
+      while (rs->readNextStartElement()) {
+        if (rs->name() == "cpu_user_s")
+          res_usage.cpu_user_s = rs->readElementText().toDouble();
+        else if (rs->name() == "cpu_system_s")
+          res_usage.cpu_system_s = rs->readElementText().toDouble();
+        else if (rs->name() == "peak_rss_kb")
+          res_usage.peak_rss_kb = rs->readElementText().toLongLong();
+        else if (rs->name() == "read_bytes")
+          res_usage.read_bytes = rs->readElementText().toLongLong();
+        else if (rs->name() == "written_bytes")
+          res_usage.written_bytes = rs->readElementText().toLongLong();
+        else
+          rs->skipCurrentElement();
+      }
     } else if (rs->name() == "step_dir") {
       js_tmp_dir_path = job_root_dir.absoluteFilePath(rs->readElementText());
     } else if (rs->name() == "problem_path") {
@@ -50,13 +410,22 @@ JobStep::JobStep(QXmlStreamReader *rs, QDir job_root_dir)
       rs->skipCurrentElement();
     }
   }
+  initTerminalLogs();
   qDebug() << tr("JobStep info: problem path %1, result_path %2").arg(problem_path).arg(result_path);
 }
 
 JobStep::~JobStep()
 {
+  // the parse and cache lookup tasks post to this object, wait for them so 
+  // that the posted calls are discarded with the object
+  if (job_step_state == ParsingResults || loading_results)
+    parse_done.acquire();
+  if (cache_lookup_pending)
+    cache_done.acquire();
   if (process != nullptr)
     delete process;
+  delete stdout_log;
+  delete stderr_log;
 }
 
 void JobStep::writeManifest(QXmlStreamWriter *ws)
@@ -70,6 +439,48 @@ void JobStep::writeManifest(QXmlStreamWriter *ws)
     ws->writeTextElement("line", line);
   ws->writeEndElement();
 
+  ws->writeStartElement("job_params");
+  for (const QString &key : job_params.keys()) {
+    ws->writeStartElement("param");
+    ws->writeAttribute("key", key);
+    ws->writeCharacters(job_params.value(key));
+    ws->writeEndElement();
+  }
+  ws->writeEndElement();
+
+  if (deps_declared) {
+    ws->writeStartElement("dependencies");
+    for (int dep : step_deps)
+      ws->writeTextElement("step", QString::number(dep));
+    ws->writeEndElement();
+  }
+
+  if (result_types_known) {
+    ws->writeStartElement("result_types");
+    for (comp::JobResult::ResultType type : result_types)
+      ws->writeTextElement("type", QVariant::fromValue(type).toString());
+    ws->writeEndElement();
+  }
+
+  // only sampled quantities are written
+  QList<QPair<QString, QString>> usage_fields;
+  if (res_usage.cpu_user_s >= 0)
+    usage_fields.append(qMakePair(QString("cpu_user_s"), QString::number(res_usage.cpu_user_s)));
+  if (res_usage.cpu_system_s >= 0)
+    usage_fields.append(qMakePair(QString("cpu_system_s"), QString::number(res_usage.cpu_system_s)));
+  if (res_usage.peak_rss_kb >= 0)
+    usage_fields.append(qMakePair(QString("peak_rss_kb"), QString::number(res_usage.peak_rss_kb)));
+  if (res_usage.read_bytes >= 0)
+    usage_fields.append(qMakePair(QString("read_bytes"), QString::number(res_usage.read_bytes)));
+  if (res_usage.written_bytes >= 0)
+    usage_fields.append(qMakePair(QString("written_bytes"), QString::number(res_usage.written_bytes)));
+  if (!usage_fields.isEmpty()) {
+    ws->writeStartElement("resource_usage");
+    for (const auto &field : usage_fields)
+      ws->writeTextElement(field.first, field.second);
+    ws->writeEndElement();
+  }
+
   QDir job_root_dir = QDir(job_tmp_dir_path);
   ws->writeComment("Paths below are relative to SimJob manifest");
   ws->writeTextElement("step_dir", job_root_dir.relativeFilePath(js_tmp_dir_path));
@@ -94,6 +505,7 @@ void JobStep::prepareJobStep(const int &t_placement,
   js_tmp_dir_path = !t_js_tmp_dir_path.isEmpty() ? t_js_tmp_dir_path
     : job_tmp_dir.absoluteFilePath(tr("step_%1").arg(placement));
   QDir(js_tmp_dir_path).mkpath(".");
+  initTerminalLogs();
 
   // set the problem and result file paths
   QDir js_tmp_dir(js_tmp_dir_path);
@@ -115,23 +527,44 @@ bool JobStep::invokeBinary()
   if (placement == -1) {
     qWarning() << "Job step execution order placement not initialized, stopping \
       invocation.";
+    job_step_state = FinishedWithError;
     return false;
   }
 
   // check if problem file exists
   if (!QFileInfo(problem_path).exists()) {
     qDebug() << tr("SimJob: problem file '%1' doesn't exist.").arg(problem_path);
+    job_step_state = FinishedWithError;
     return false;
   }
 
   // check if binary path of simulation engine exists
   if (!QFileInfo(engine->binaryPath()).exists()) {
     qDebug() << tr("SimJob: engine binary/script '%1' doesn't exist.").arg(engine->binaryPath());
+    job_step_state = FinishedWithError;
     return false;
   }
 
   job_step_state = Running;
 
+  // look up the result of an identical job step in the cache, the key hashes 
+  // the whole problem file and a hit copies the cached files so both are done
+  // off the GUI thread and the process is started once the lookup misses
+  if (use_result_cache && ResultCache::instance()->loadSettings()) {
+    QFileInfo bin_info(engine->binaryPath());
+    QString engine_id = QStringList({engine->name(), engine->version(),
+        bin_info.absoluteFilePath(), QString::number(bin_info.size()),
+        QString::number(bin_info.lastModified().toMSecsSinceEpoch())}).join("\n");
+    cache_lookup_pending = true;
+    QThreadPool::globalInstance()->start(new CacheLookupTask(this, engine_id));
+    return true;
+  }
+
+  return startProcess();
+}
+
+bool JobStep::startProcess()
+{
   qDebug() << tr("Job step %1 about to execute command: %2")
     .arg(placement).arg(command.join(" "));
 
@@ -150,6 +583,7 @@ bool JobStep::invokeBinary()
   qDebug() << tr("Waiting for process start success signal...");
   if (!process->waitForStarted()) {
     qCritical() << tr("Failed to start plugin process.");
+    job_step_state = FinishedWithError;
     return false;
   } else {
     qDebug() << "Job step process started successfully.";
@@ -159,33 +593,104 @@ bool JobStep::invokeBinary()
   connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
           this, &JobStep::processJobStepCompletion);
 
+  // sample the resources used by the process until it exits
+  usage_timer = new QTimer(this);
+  connect(usage_timer, &QTimer::timeout, this, &JobStep::sampleResourceUsage);
+  usage_timer->start(usage_sample_ms);
+  sampleResourceUsage();
+
   // read out standard output and error messages
   connect(process, &QProcess::readyReadStandardOutput,
           [this]()
           {
-            std_out.append(QString::fromUtf8(process->readAllStandardOutput()));
+            stdout_log->append(process->readAllStandardOutput());
           });
   connect(process, &QProcess::readyReadStandardError,
           [this]()
           {
-            std_err.append(QString::fromUtf8(process->readAllStandardError()));
+            stderr_log->append(process->readAllStandardError());
           });
 
   return true;
 }
 
-bool JobStep::readResults(bool attempt_import_logs)
+void JobStep::cacheLookedUp(QString key, bool restored)
+{
+  // the lookup task has released the semaphore before this queued call runs
+  cache_done.acquire();
+  cache_lookup_pending = false;
+  cache_key = key;
+
+  if (terminate_requested) {
+    finishJobStep(false);
+    return;
+  }
+
+  if (restored) {
+    qDebug() << tr("Job step %1 restored from result cache %2.")
+      .arg(placement).arg(cache_key);
+    result_from_cache = true;
+    start_time = QDateTime::currentDateTime();
+    processJobStepCompletion(0, QProcess::NormalExit);
+    return;
+  }
+
+  // the caller of invokeBinary has already counted this step as running, a 
+  // failed start is reported through the finish signal instead
+  if (!startProcess())
+    finishJobStep(false);
+}
+
+bool JobStep::readResults()
 {
   if (results_read) {
     qDebug() << "Results have already been read.";
     return true;
   }
 
+  ParsedResults parsed = parseResultFile(result_path);
+  adoptParsedResults(parsed);
+  return parsed.success;
+}
+
+void JobStep::loadResultsInBackground(SimJob *archive_job)
+{
+  if (results_read || loading_results)
+    return;
+  loading_results = true;
+  QThreadPool::globalInstance()->start(new ResultParseTask(this, archive_job));
+}
+
+void JobStep::adoptParsedResults(ParsedResults &parsed)
+{
+  // results read before, e.g. partially streamed ones, are replaced
+  qDeleteAll(job_results);
+  job_results = parsed.job_results;
+  eng_stats = parsed.eng_stats;
+  parsed.job_results.clear();
+  results_read = parsed.success;
+  result_types = job_results.keys();
+  result_types_known = true;
+}
+
+void JobStep::releaseResults()
+{
+  qDeleteAll(job_results);
+  job_results.clear();
+  results_read = false;
+}
+
+JobStep::ParsedResults JobStep::parseResultFile(const QString &result_path)
+{
+  ParsedResults parsed;
+  QMap<comp::JobResult::ResultType, comp::JobResult*> &job_results = parsed.job_results;
+  EngineStats &eng_stats = parsed.eng_stats;
+
   QFile result_file(result_path);
 
   if(!result_file.open(QFile::ReadOnly | QFile::Text)){
     qDebug() << tr("Error when opening job step result file to read: %1").arg(result_file.errorString());
-    return false;
+    return parsed;
   }
 
   QXmlStreamReader rs(&result_file);
@@ -220,8 +725,23 @@ bool JobStep::readResults(bool attempt_import_logs)
           // TODO implement
           rs.skipCurrentElement();
         } else if (rs.name() == "time_elapsed_s") {
-          // TODO implement
-          rs.skipCurrentElement();
+          eng_stats.time_elapsed_s = rs.readElementText().toDouble();
+        } else if (rs.name() == "cpu_user_s") {
+          eng_stats.cpu_user_s = rs.readElementText().toDouble();
+        } else if (rs.name() == "cpu_system_s") {
+          eng_stats.cpu_system_s = rs.readElementText().toDouble();
+        } else if (rs.name() == "peak_rss_kb") {
+          eng_stats.peak_rss_kb = rs.readElementText().toLongLong();
+        } else if (rs.name() == "phases") {
+          while (rs.readNextStartElement()) {
+            if (rs.name() == "phase") {
+              QString phase_name = rs.attributes().value("name").toString();
+              eng_stats.phase_times.append(qMakePair(phase_name,
+                    rs.readElementText().toDouble()));
+            } else {
+              unrecognizedXMLElement(rs);
+            }
+          }
         } else {
           unrecognizedXMLElement(rs);
         }
@@ -233,11 +753,20 @@ bool JobStep::readResults(bool attempt_import_logs)
       job_results.insert(comp::JobResult::DBLocationsResult,
                          new comp::DBLocations(&rs));
     } else if (rs.name() == "elec_dist") {
-      job_results.insert(comp::JobResult::ChargeConfigsResult,
-                         new comp::ChargeConfigSet(&rs));
+      // plugins streaming their results may write multiple sections
+      if (job_results.contains(comp::JobResult::ChargeConfigsResult))
+        static_cast<comp::ChargeConfigSet*>(job_results.value(
+              comp::JobResult::ChargeConfigsResult))->readFromXMLStream(&rs);
+      else
+        job_results.insert(comp::JobResult::ChargeConfigsResult,
+                           new comp::ChargeConfigSet(&rs));
     } else if (rs.name() == "potential_map") {
-      job_results.insert(comp::JobResult::PotentialLandscapeResult,
-                         new comp::PotentialLandscape(&rs, QFileInfo(resultPath()).absolutePath()));
+      if (job_results.contains(comp::JobResult::PotentialLandscapeResult))
+        static_cast<comp::PotentialLandscape*>(job_results.value(
+              comp::JobResult::PotentialLandscapeResult))->readFromXMLStream(&rs);
+      else
+        job_results.insert(comp::JobResult::PotentialLandscapeResult,
+                           new comp::PotentialLandscape(&rs, QFileInfo(result_path).absolutePath()));
     } else if (rs.name() == "sqcommands") {
       job_results.insert(comp::JobResult::SQCommandsResult,
                         new comp::SQCommands(&rs));
@@ -257,55 +786,48 @@ bool JobStep::readResults(bool attempt_import_logs)
 
   // TODO remove line scans support from SiQADConn
 
-  if(rs.hasError()){
+  if (rs.error() == QXmlStreamReader::PrematureEndOfDocumentError) {
+    // results streamed by plugins that were terminated or crashed end
+    // abruptly, keep whatever has been read
+    qWarning() << tr("Result file ended prematurely, only partial results "
+        "have been read.");
+  } else if(rs.hasError()){
     qCritical() << tr("Failed to read results, XML error - ") << rs.errorString().data();
-    return false;
-  }
-
-  // try to read std out and std error from log files if indicated (normally 
-  // these are acquired from the QProcess, so only applicable when importing 
-  // a job from manifest.)
-  auto importLogFromFilePath = [](QString &s, const QString &fpath)
-  {
-    QFile file(fpath);
-    if (!file.open(QFile::ReadOnly | QFile::Text)) {
-      qWarning() << tr("File cannot be opened for reading: %1").arg(fpath);
-      return;
-    }
-    s = QString(file.readAll());
-  };
-  if (attempt_import_logs) {
-    QDir js_tmp_dir(js_tmp_dir_path);
-    importLogFromFilePath(std_out, js_tmp_dir.absoluteFilePath("runtime_stdout.log"));
-    importLogFromFilePath(std_err, js_tmp_dir.absoluteFilePath("runtime_stderr.log"));
+    return parsed;
   }
 
   qDebug() << tr("Successfully read job step result.");
   result_file.close();
 
-  results_read = true;
-  return true;
+  parsed.success = true;
+  return parsed;
 }
 
 void JobStep::exportTerminalOutputs(QString std_out_path, QString std_err_path)
 {
-  // store std out and std error into file log
-  auto writeToFilePath = [](const QString &s, const QString &fpath)
+  // the captured logs are already on disk, copy them unless they are the 
+  // requested files
+  auto exportLog = [](LogCapture *log, const QString &fpath)
   {
-    QFile file(fpath);
-    if (!file.open(QFile::WriteOnly)) {
-      qWarning() << tr("Failed to open file to write: %1").arg(fpath);
+    if (log == nullptr)
       return;
-    }
-    file.write(s.toLocal8Bit());
-    file.close();
+    log->flush();
+    if (QFileInfo(fpath) == QFileInfo(log->filePath()))
+      return;
+    QFile::remove(fpath);
+    if (QFileInfo::exists(log->filePath()) && !QFile::copy(log->filePath(), fpath))
+      qWarning() << tr("Failed to open file to write: %1").arg(fpath);
   };
-  writeToFilePath(std_out, std_out_path);
-  writeToFilePath(std_err, std_err_path);
+  exportLog(stdout_log, std_out_path);
+  exportLog(stderr_log, std_err_path);
 }
 
 void JobStep::terminateJobStep()
 {
+  // a step still looking up the cache finishes when the lookup returns
+  terminate_requested = true;
+  if (process == nullptr)
+    return;
 #ifdef _WIN32
   process->kill();
 #else
@@ -320,15 +842,124 @@ void JobStep::processJobStepCompletion(int t_exit_code, QProcess::ExitStatus t_e
   qDebug() << tr("Job step %1 finished with exit code %2 and status %3.")
     .arg(placement).arg(exit_code).arg(str_exit_status);
   end_time = QDateTime::currentDateTime();
+  if (usage_timer != nullptr)
+    usage_timer->stop();
 
   bool successful = (exit_code == 0) && (exit_status == QProcess::NormalExit);
-  if (successful)
-    readResults();
+
+  // unsuccessful job steps may still have streamed partial results, large 
+  // result files take a while to parse so that is done off the GUI thread
+  if (successful || QFileInfo::exists(result_path)) {
+    exit_successful = successful;
+    job_step_state = ParsingResults;
+    emit sig_jobStepParsingResults(placement);
+    QThreadPool::globalInstance()->start(new ResultParseTask(this));
+    return;
+  }
+
+  finishJobStep(successful);
+}
+
+void JobStep::sampleResourceUsage()
+{
+#ifdef __linux__
+  if (process == nullptr || process->state() != QProcess::Running)
+    return;
+  QDir proc_dir(QString("/proc/%1").arg(process->processId()));
+
+  // CPU times are fields 14 to 17 of stat, counted after the parenthesized 
+  // command name which may contain spaces
+  QFile stat_file(proc_dir.filePath("stat"));
+  if (stat_file.open(QFile::ReadOnly)) {
+    QByteArray stat = stat_file.readAll();
+    QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+    if (fields.length() > 14) {
+      double ticks_per_s = sysconf(_SC_CLK_TCK);
+      res_usage.cpu_user_s = (fields[11].toLongLong() + fields[13].toLongLong()) / ticks_per_s;
+      res_usage.cpu_system_s = (fields[12].toLongLong() + fields[14].toLongLong()) / ticks_per_s;
+    }
+  }
+
+  // the high water mark of the resident set size is kept by the kernel
+  QFile status_file(proc_dir.filePath("status"));
+  if (status_file.open(QFile::ReadOnly)) {
+    for (const QByteArray &line : status_file.readAll().split('\n'))
+      if (line.startsWith("VmHWM:"))
+        res_usage.peak_rss_kb = line.mid(6).simplified().split(' ').first().toLongLong();
+  }
+
+  QFile io_file(proc_dir.filePath("io"));
+  if (io_file.open(QFile::ReadOnly)) {
+    for (const QByteArray &line : io_file.readAll().split('\n')) {
+      if (line.startsWith("rchar:"))
+        res_usage.read_bytes = line.mid(6).trimmed().toLongLong();
+      else if (line.startsWith("wchar:"))
+        res_usage.written_bytes = line.mid(6).trimmed().toLongLong();
+    }
+  }
+#endif
+}
+
+void JobStep::mergeEngineStats()
+{
+  // the engine measures up to its exit while sampling stops at the last 
+  // usage_sample_ms tick, so the larger value is the more complete one
+  res_usage.cpu_user_s = qMax(res_usage.cpu_user_s, eng_stats.cpu_user_s);
+  res_usage.cpu_system_s = qMax(res_usage.cpu_system_s, eng_stats.cpu_system_s);
+  res_usage.peak_rss_kb = qMax(res_usage.peak_rss_kb, eng_stats.peak_rss_kb);
+}
+
+void JobStep::resultsParsed()
+{
+  // the parse task has released the semaphore before this queued call runs
+  parse_done.acquire();
+
+  // results loaded on demand don't change the state of the step
+  if (loading_results) {
+    loading_results = false;
+    adoptParsedResults(pending_results);
+    emit sig_jobStepResultsLoaded(placement);
+    return;
+  }
+
+  bool parse_successful = pending_results.success;
+  adoptParsedResults(pending_results);
+  if (!result_from_cache)
+    mergeEngineStats();
+
+  // a process that exited normally without leaving a readable result file 
+  // hasn't completed its step
+  if (exit_successful && !parse_successful)
+    qWarning() << tr("Job step %1 exited normally but its result file %2 "
+        "couldn't be parsed.").arg(placement).arg(result_path);
+  finishJobStep(exit_successful && parse_successful);
+}
+
+void JobStep::finishJobStep(bool successful)
+{
+  job_step_state = successful ? FinishedNormally : FinishedWithError;
+
+  // only results of complete runs are cached
+  stdout_log->flush();
+  stderr_log->flush();
+  if (successful && use_result_cache && !result_from_cache && !cache_key.isEmpty()
+      && ResultCache::instance()->loadSettings())
+    QThreadPool::globalInstance()->start(new CacheStoreTask(cache_key,
+          js_tmp_dir_path, result_path, problem_path));
 
   // inform the parent of the success state.
   emit sig_jobStepFinishState(placement, successful);
 }
 
+void JobStep::initTerminalLogs()
+{
+  if (stdout_log != nullptr || js_tmp_dir_path.isEmpty())
+    return;
+  QDir js_tmp_dir(js_tmp_dir_path);
+  stdout_log = new LogCapture(js_tmp_dir.absoluteFilePath("runtime_stdout.log"));
+  stderr_log = new LogCapture(js_tmp_dir.absoluteFilePath("runtime_stderr.log"));
+}
+
 bool JobStep::commandKeywordReplacement()
 {
   // keywords are not properly initialized if prepareJobStep hasn't been called
@@ -378,26 +1009,15 @@ SimJob::SimJob(const QString &fpath, bool dcmp, QString name_override,
     imported(true)
 {
   QString manifest_path;
+  QByteArray manifest_data;
   gui_ctrl_elems.pb_terminate->setDisabled(true);
 
-  auto find_manifest = [](QDir xdir)
-  {
-    QDirIterator it(xdir, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-      it.next();
-      if (it.fileInfo().fileName() == "manifest.xml") {
-        return it.fileInfo().absoluteFilePath();
-      }
-    }
-    return QString();
-  };
-
   // lambda function for importing job steps
-  auto importJobSteps = [this](QXmlStreamReader &rs, QFile &file)
+  auto importJobSteps = [this](QXmlStreamReader &rs, const QDir &job_root_dir)
   {
     while (rs.readNextStartElement()) {
       if (rs.name() == "job_step") {
-        job_steps.append(new JobStep(&rs, QFileInfo(file).dir()));
+        job_steps.append(new JobStep(&rs, job_root_dir));
       } else {
         qWarning() << tr("Unknown XML tag encountered when importing job steps:"
            " %1").arg(rs.name().toString());
@@ -406,16 +1026,33 @@ SimJob::SimJob(const QString &fpath, bool dcmp, QString name_override,
     }
   };
 
-  // decompress the archive if dcmp flag is true
+  // read the manifest from the central directory of the archive if dcmp flag
+  // is true, job step files are only decompressed when they're needed
   if (dcmp) {
-    qDebug() << "Decompressing SimJob archive...";
+    qDebug() << "Reading SimJob archive directory...";
     QString tmpd = settings::AppSettings::instance()->getPath("plugs/runtime_tmp_root_path");
-    QDir xdir(QDir(tmpd).absoluteFilePath("IM_" + QDateTime::currentDateTime().toString("yyMMdd_HHmmss")));
-    zipper::Unzipper unzipper(fpath.toStdString());
-    unzipper.extract(xdir.absolutePath().toStdString());
-    qDebug() << "Searching for SimJob manifest...";
-    manifest_path = find_manifest(xdir);
-    if (manifest_path.isEmpty()) {
+    archive_xdir_path = QDir(tmpd).absoluteFilePath("IM_" + QDateTime::currentDateTime().toString("yyMMdd_HHmmss"));
+    QString manifest_entry;
+    try {
+      archive = new zipper::Unzipper(fpath.toStdString());
+      for (const zipper::ZipEntry &entry : archive->entries()) {
+        QString name = QString::fromStdString(entry.name);
+        if (name.endsWith("/"))
+          continue;
+        archive_entries.append(name);
+        // the shallowest manifest is the job manifest
+        if (QFileInfo(name).fileName() == "manifest.xml"
+            && (manifest_entry.isEmpty() || name.count("/") < manifest_entry.count("/")))
+          manifest_entry = name;
+      }
+      std::vector<unsigned char> data;
+      if (!manifest_entry.isEmpty()
+          && archive->extractEntryToMemory(manifest_entry.toStdString(), data))
+        manifest_data = QByteArray(reinterpret_cast<const char*>(data.data()), data.size());
+    } catch (const std::exception &e) {
+      qWarning() << tr("Error when reading archive %1: %2").arg(fpath).arg(e.what());
+    }
+    if (manifest_data.isEmpty()) {
       QMessageBox msg;
       msg.setText("manifest.xml not found in the provided archive. Import halted.");
       msg.exec();
@@ -423,17 +1060,18 @@ SimJob::SimJob(const QString &fpath, bool dcmp, QString name_override,
       gui_ctrl_elems.pb_terminate->setText("Import Error");
       return;
     }
+    manifest_path = QDir(archive_xdir_path).absoluteFilePath(manifest_entry);
   } else {
     manifest_path = fpath;
+    QFile file(manifest_path);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+      qWarning() << tr("Error when opening file to read: %1").arg(file.errorString());
+      return;
+    }
+    manifest_data = file.readAll();
+    file.close();
   }
-
-  // get file and XML stream
-  QFile file(manifest_path);
-  if (!file.open(QFile::ReadOnly | QFile::Text)) {
-    qWarning() << tr("Error when opening file to read: %1").arg(file.errorString());
-    return;
-  }
-  QXmlStreamReader rs(&file);
+  QXmlStreamReader rs(manifest_data);
 
   // read manifest from stream
   qDebug() << "Reading SimJob manifest";
@@ -462,7 +1100,10 @@ SimJob::SimJob(const QString &fpath, bool dcmp, QString name_override,
       // TODO implement
       rs.skipCurrentElement();
     } else if (rs.name() == "job_steps") {
-      importJobSteps(rs, file);
+      importJobSteps(rs, QFileInfo(manifest_path).dir());
+    } else if (rs.name() == "sweep_keys") {
+      while (rs.readNextStartElement())
+        sweep_keys.append(rs.readElementText());
     } else {
       qWarning() << tr("Unknown XML tag encountered when importing SimJob: %1")
         .arg(rs.name().toString());
@@ -477,25 +1118,119 @@ SimJob::SimJob(const QString &fpath, bool dcmp, QString name_override,
     job_name = name_override;
   }
 
-  // import results
-  qDebug() << "Reading JobStep results";
+  // map result types to steps from the manifest, results are only read for
+  // steps of manifests that predate recording their result types and their
+  // types are mapped once the results have been loaded
   for (JobStep *js : job_steps) {
-    js->readResults(true);
-    for (comp::JobResult::ResultType type : js->jobResults().keys()) {
+    if (!js->resultTypesKnown()) {
+      qDebug() << tr("Reading results of job step %1").arg(js->jobStepPlacement());
+      loadStepResults(js);
+    }
+    for (comp::JobResult::ResultType type : js->resultTypes()) {
       result_type_step_map.insert(type, js);
     }
   }
   gui_ctrl_elems.pb_terminate->setText("Imported");
-
-  // clean up
-  file.close();
+  gui_ctrl_elems.pb_sweep_results->setEnabled(isSweep());
 }
 
 SimJob::~SimJob()
 {
+  // the problem export task posts to this object, wait for it so that the
+  // posted call is discarded with the object
+  if (exporting_problems)
+    export_done.acquire();
+  if (job_export_running) {
+    job_export_cancelled.storeRelease(1);
+    job_export_done.acquire();
+  }
   for (JobStep *job_step : job_steps) {
     delete job_step;
   }
+  delete archive;
+}
+
+bool SimJob::holdStepResults(JobStep *js, const QString &holder)
+{
+  result_holders.insert(holder, js);
+  return loadStepResults(js);
+}
+
+bool SimJob::loadStepResults(JobStep *js)
+{
+  // results of running steps are adopted when the step finishes, steps of 
+  // imported jobs have finished whatever state their manifest recorded
+  if (!imported && js->jobStepState() != JobStep::FinishedNormally
+      && js->jobStepState() != JobStep::FinishedWithError)
+    return js->resultsLoaded();
+
+  if (!js->resultsLoaded()) {
+    connect(js, &JobStep::sig_jobStepResultsLoaded,
+            this, &SimJob::stepResultsLoaded, Qt::UniqueConnection);
+    js->loadResultsInBackground(archive != nullptr ? this : nullptr);
+    return false;
+  }
+
+  touchLoadedStep(js);
+  return true;
+}
+
+void SimJob::stepResultsLoaded(int placement)
+{
+  JobStep *js = nullptr;
+  for (JobStep *step : job_steps)
+    if (step->jobStepPlacement() == placement)
+      js = step;
+  if (js == nullptr)
+    return;
+
+  for (comp::JobResult::ResultType type : js->resultTypes())
+    if (!result_type_step_map.contains(type, js))
+      result_type_step_map.insert(type, js);
+  touchLoadedStep(js);
+  emit sig_stepResultsLoaded(js);
+}
+
+void SimJob::touchLoadedStep(JobStep *js)
+{
+  // release the least recently used results that nobody holds
+  loaded_steps.removeAll(js);
+  loaded_steps.append(js);
+  int max_loaded = qMax(1, settings::AppSettings::instance()->get<int>("plugs/max_loaded_job_steps"));
+  QList<JobStep*> held_steps = result_holders.values();
+  for (int i=0; i<loaded_steps.length() && loaded_steps.length() > max_loaded;) {
+    JobStep *lru_step = loaded_steps.at(i);
+    if (lru_step == js || held_steps.contains(lru_step)) {
+      i++;
+      continue;
+    }
+    qDebug() << tr("Releasing results of job step %1").arg(lru_step->jobStepPlacement());
+    lru_step->releaseResults();
+    loaded_steps.removeAt(i);
+  }
+}
+
+bool SimJob::extractFromArchive(const QString &path)
+{
+  if (archive == nullptr)
+    return true;
+
+  // result parse tasks decompress from worker threads
+  QMutexLocker locker(&archive_mutex);
+  QString name = QDir(archive_xdir_path).relativeFilePath(path);
+  bool ok = true;
+  for (const QString &entry : archive_entries) {
+    if ((entry != name && !entry.startsWith(name + "/"))
+        || extracted_entries.contains(entry))
+      continue;
+    if (archive->extractEntry(entry.toStdString(), archive_xdir_path.toStdString())) {
+      extracted_entries.insert(entry);
+    } else {
+      qWarning() << tr("Failed to decompress %1 from the job archive.").arg(entry);
+      ok = false;
+    }
+  }
+  return ok;
 }
 
 void SimJob::writeManifest(QString fpath)
@@ -529,6 +1264,13 @@ void SimJob::writeManifest(QXmlStreamWriter *ws)
     ws->writeTextElement("time_end", QVariant::fromValue(end_time).toString());
   }
 
+  if (isSweep()) {
+    ws->writeStartElement("sweep_keys");
+    for (const QString &key : sweep_keys)
+      ws->writeTextElement("key", key);
+    ws->writeEndElement();
+  }
+
   // all job steps
   ws->writeStartElement("job_steps");
   for (JobStep *js : job_steps) {
@@ -540,6 +1282,120 @@ void SimJob::writeManifest(QXmlStreamWriter *ws)
   ws->writeEndElement();
 }
 
+QList<SimJob::SweepParameter> SimJob::parseSweepSpec(const QString &spec,
+    const gui::PropertyMap &prop_map, QString *err_msg)
+{
+  QList<SweepParameter> sweep;
+  auto fail = [&sweep, err_msg](const QString &msg)
+  {
+    if (err_msg != nullptr)
+      *err_msg = msg;
+    sweep.clear();
+    return sweep;
+  };
+
+  for (QString line : spec.split("\n", QString::SkipEmptyParts)) {
+    line = line.trimmed();
+    if (line.isEmpty())
+      continue;
+    int eq_ind = line.indexOf("=");
+    if (eq_ind == -1)
+      return fail(tr("Sweep line '%1' is not in the form 'key = values'.").arg(line));
+
+    SweepParameter param;
+    param.key = line.left(eq_ind).trimmed();
+    QString val_spec = line.mid(eq_ind+1).trimmed();
+    if (!prop_map.contains(param.key))
+      return fail(tr("Sweep parameter '%1' is not a parameter of this plugin.").arg(param.key));
+    for (const SweepParameter &other : sweep)
+      if (other.key == param.key)
+        return fail(tr("Sweep parameter '%1' is given more than once.").arg(param.key));
+
+    QStringList range = val_spec.split(":");
+    if (range.length() == 3) {
+      // evenly spaced values from start to stop inclusive
+      bool start_ok, stop_ok, count_ok;
+      double start = range[0].toDouble(&start_ok);
+      double stop = range[1].toDouble(&stop_ok);
+      int count = range[2].toInt(&count_ok);
+      if (!start_ok || !stop_ok || !count_ok || count < 1)
+        return fail(tr("Sweep range '%1' of parameter '%2' is not in the form "
+              "'start:stop:count'.").arg(val_spec).arg(param.key));
+      for (int i=0; i<count; i++) {
+        double val = (count == 1) ? start : start + i * (stop - start) / (count - 1);
+        param.values.append(QString::number(val, 'g', 12));
+      }
+    } else {
+      for (const QString &val : val_spec.split(",", QString::SkipEmptyParts))
+        if (!val.trimmed().isEmpty())
+          param.values.append(val.trimmed());
+    }
+    if (param.values.isEmpty())
+      return fail(tr("Sweep parameter '%1' has no values.").arg(param.key));
+
+    // check that the values suit the property
+    const gui::Property &prop = prop_map.value(param.key);
+    for (const QString &val : param.values) {
+      bool ok = true;
+      if (prop.value_selection.type == gui::Combo) {
+        ok = false;
+        for (const gui::ComboOption &opt : prop.value_selection.combo_options)
+          ok |= opt.val.toString() == val;
+      } else {
+        switch (prop.value.userType()) {
+          case QMetaType::Int:
+            val.toInt(&ok);
+            break;
+          case QMetaType::Float:
+          case QMetaType::Double:
+            val.toDouble(&ok);
+            break;
+          default:
+            break;
+        }
+      }
+      if (!ok)
+        return fail(tr("Value '%1' is not valid for sweep parameter '%2'.")
+            .arg(val).arg(param.key));
+    }
+    sweep.append(param);
+  }
+
+  if (sweep.isEmpty())
+    return fail(tr("The sweep specification contains no parameters."));
+  return sweep;
+}
+
+void SimJob::addSweepSteps(PluginEngine *engine, const QStringList &command_format,
+    const gui::PropertyMap &prop_map, const QList<SweepParameter> &sweep)
+{
+  // odometer over the value indices of each swept parameter, the last 
+  // parameter varying fastest
+  QVector<int> val_inds(sweep.length(), 0);
+  bool done = sweep.isEmpty();
+  while (!done) {
+    gui::PropertyMap step_map(prop_map);
+    for (int i=0; i<sweep.length(); i++)
+      step_map[sweep[i].key].value = sweep[i].values[val_inds[i]];
+    JobStep *js = new JobStep(engine, command_format, step_map);
+    js->setDependencies(QList<int>());
+    addJobStep(js);
+
+    done = true;
+    for (int i=sweep.length()-1; i>=0; i--) {
+      if (++val_inds[i] < sweep[i].values.length()) {
+        done = false;
+        break;
+      }
+      val_inds[i] = 0;
+    }
+  }
+
+  for (const SweepParameter &param : sweep)
+    sweep_keys.append(param.key);
+  gui_ctrl_elems.pb_sweep_results->setEnabled(isSweep());
+}
+
 void SimJob::confirmJobStepsPlacement()
 {
   if (placement_confirmed)
@@ -557,66 +1413,193 @@ void SimJob::prepareJob()
     confirmJobStepsPlacement();
   }
 
-  // export problem files for all job steps
-  qDebug() << "Exporting job step problem files...";
-  for (JobStep *job_step : job_steps) {
-    emit sig_exportJobStepProblem(job_step, inclusion_area);
-  }
-
   // connect necessary signals
   for (JobStep *job_step : job_steps) {
     connect(job_step, &comp::JobStep::sig_jobStepFinishState,
             this, &SimJob::continueJob);
+    connect(job_step, &comp::JobStep::sig_jobStepParsingResults,
+            this, &SimJob::updateRunningStatus);
   }
 
   // write job manifest
   writeManifest();
+
+  // request the design snapshot that the problem files are written from
+  qDebug() << "Exporting job step problem files...";
+  emit sig_exportJobProblems(this, inclusion_area);
+}
+
+void SimJob::queueJob()
+{
+  job_state = Queued;
+  gui_ctrl_elems.pb_terminate->setText("Cancel");
+}
+
+int SimJob::coreWeight() const
+{
+  int weight = 1;
+  for (JobStep *js : job_steps)
+    weight = qMax(weight, js->pluginEngine()->coreWeight());
+  return weight * max_concurrent_steps;
+}
+
+QList<int> SimJob::stepDependencies(int i) const
+{
+  JobStep *js = job_steps.at(i);
+  if (js->dependenciesDeclared())
+    return js->dependencies();
+  return (i > 0) ? QList<int>({i-1}) : QList<int>();
+}
+
+int SimJob::maxParallelSteps() const
+{
+  // ancestors[i][j] is true if step i (transitively) depends on step j, 
+  // dependencies always point to earlier placements
+  int n = job_steps.length();
+  QVector<QVector<bool>> ancestors(n, QVector<bool>(n, false));
+  for (int i=0; i<n; i++) {
+    for (int dep : stepDependencies(i)) {
+      if (dep < 0 || dep >= i)
+        continue;
+      ancestors[i][dep] = true;
+      for (int j=0; j<dep; j++)
+        ancestors[i][j] = ancestors[i][j] || ancestors[dep][j];
+    }
+  }
+
+  // steps that can run at the same time are pairwise independent, by 
+  // Dilworth's theorem the largest such set is as large as the fewest 
+  // dependency chains covering all steps, which is n minus a maximum 
+  // matching of steps to their descendants
+  QVector<int> matched_ancestor(n, -1);   // step matched before each step in its chain
+  QVector<bool> visited;
+  std::function<bool(int)> augment = [&](int i)
+  {
+    for (int j=i+1; j<n; j++) {
+      if (!ancestors[j][i] || visited[j])
+        continue;
+      visited[j] = true;
+      if (matched_ancestor[j] == -1 || augment(matched_ancestor[j])) {
+        matched_ancestor[j] = i;
+        return true;
+      }
+    }
+    return false;
+  };
+  int matching = 0;
+  for (int i=0; i<n; i++) {
+    visited.fill(false, n);
+    if (augment(i))
+      matching++;
+  }
+  return n - matching;
 }
 
 bool SimJob::beginJob()
 {
+  job_state = Running;
+  gui_ctrl_elems.pb_terminate->setText("Exporting problems...");
   if (!placement_confirmed)
     prepareJob();
+  return job_state == Running;
+}
 
-  qDebug() << "Beginning job step invocation.";
-  job_state = Running;
-  curr_step = job_steps.at(0);
-  return job_steps.at(0)->invokeBinary();
+void SimJob::exportProblems(const QByteArray &design_snapshot)
+{
+  exporting_problems = true;
+  QThreadPool::globalInstance()->start(
+      new ProblemExportTask(this, job_steps, design_snapshot));
 }
 
-void SimJob::continueJob(int prev_step_ind, bool prev_step_successful)
+void SimJob::problemsExported(bool successful)
 {
-  if (!prev_step_successful) {
-    qDebug() << tr("Last job step finished unsuccessfully, ceasing job.");
+  export_done.acquire();
+  exporting_problems = false;
+  if (job_state != Running)
+    return;
+
+  if (!successful || terminate_requested) {
+    qWarning() << tr("Job %1 halted before invoking its steps.").arg(job_name);
     jobFinishActions(FinishedWithError);
     return;
   }
 
-  qDebug() << tr("Received step completion notice from job step %1.").arg(prev_step_ind);
-
-  qDebug() << tr("Prev step engine name %1").arg(job_steps[0]->pluginEngine()->name());
-  qDebug() << tr("job_steps.length=%1").arg(job_steps.length());
+  qDebug() << "Beginning job step invocation.";
+  gui_ctrl_elems.pb_terminate->setText("Terminate");
+  invokeReadySteps();
+}
 
-  for (comp::JobResult::ResultType type : job_steps.at(prev_step_ind)->jobResults().keys())
-    result_type_step_map.insert(type, job_steps.at(prev_step_ind));
+void SimJob::continueJob(int prev_step_ind, bool prev_step_successful)
+{
+  qDebug() << tr("Received step completion notice from job step %1.").arg(prev_step_ind);
+  running_steps--;
 
-  int i = prev_step_ind + 1;
-  if (i < job_steps.length()) {
-    // invoke next step if any
-    job_steps.at(i)->invokeBinary();
-    curr_step = job_steps.at(i);
+  if (prev_step_successful) {
+    for (comp::JobResult::ResultType type : job_steps.at(prev_step_ind)->jobResults().keys())
+      result_type_step_map.insert(type, job_steps.at(prev_step_ind));
   } else {
-    // wrap up job if no more steps
-    curr_step = nullptr;
-    jobFinishActions(FinishedNormally);
+    qDebug() << tr("Job step %1 finished unsuccessfully, steps depending on it "
+        "won't be invoked.").arg(prev_step_ind);
   }
+
+  invokeReadySteps();
+  updateRunningStatus();
   writeManifest();
 }
 
 void SimJob::terminateJob()
 {
-  if (curr_step != nullptr)
-    curr_step->terminateJobStep();
+  if (job_state == Queued) {
+    jobFinishActions(FinishedWithError);
+    gui_ctrl_elems.pb_terminate->setText("Cancelled");
+  } else {
+    terminate_requested = true;
+    for (JobStep *js : job_steps)
+      if (js->jobStepState() == JobStep::Running)
+        js->terminateJobStep();
+  }
+}
+
+void SimJob::invokeReadySteps()
+{
+  for (int i=0; i<job_steps.length(); i++) {
+    if (terminate_requested || running_steps >= max_concurrent_steps)
+      break;
+    JobStep *js = job_steps.at(i);
+    if (js->jobStepState() != JobStep::NotInvoked)
+      continue;
+    // dependencies always point to earlier placements
+    bool ready = true;
+    for (int dep : stepDependencies(i))
+      ready = ready && dep >= 0 && dep < i
+        && job_steps.at(dep)->jobStepState() == JobStep::FinishedNormally;
+    if (!ready)
+      continue;
+    if (js->invokeBinary()) {
+      running_steps++;
+    } else {
+      qWarning() << tr("Job step %1 could not be invoked.").arg(i);
+    }
+  }
+
+  if (running_steps == 0 && job_state == Running) {
+    // anything not invoked by now depends on a failed step
+    bool all_finished = true;
+    for (JobStep *js : job_steps)
+      all_finished = all_finished && js->jobStepState() == JobStep::FinishedNormally;
+    jobFinishActions((all_finished && !terminate_requested) ? FinishedNormally
+        : FinishedWithError);
+  }
+}
+
+void SimJob::updateRunningStatus()
+{
+  if (job_state != Running)
+    return;
+  bool parsing = false;
+  for (JobStep *js : job_steps)
+    parsing = parsing || js->jobStepState() == JobStep::ParsingResults;
+  gui_ctrl_elems.pb_terminate->setText(parsing ? "Parsing results..." : "Terminate");
 }
 
 void SimJob::jobFinishActions(JobState t_job_state)
@@ -701,34 +1684,63 @@ QWidget *SimJob::terminalOutputDialog(QWidget *parent, Qt::WindowFlags w_flags)
   lw_job_steps->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Preferred);
   sw_job_term_outs->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
 
+  QList<std::function<void()>> show_last_pages;
   for (JobStep *js : job_steps) {
     lw_job_steps->addItem(tr("Step %1").arg(js->jobStepPlacement()));
 
     QComboBox *cb_channel = new QComboBox();
     QPlainTextEdit *te_js_term_out = new QPlainTextEdit;
+    QSpinBox *sb_page = new QSpinBox();
+    QPushButton *pb_refresh = new QPushButton("Refresh");
+    te_js_term_out->setReadOnly(true);
 
-    QString str_stdout = "Standard Output";
-    QString str_stderr = "Standard Error";
-    cb_channel->addItem(str_stdout);
-    cb_channel->addItem(str_stderr);
+    cb_channel->addItem("Standard Output", QProcess::StandardOutput);
+    cb_channel->addItem("Standard Error", QProcess::StandardError);
 
-    auto showChannelText = [js, te_js_term_out, str_stdout, str_stderr](const QString &str_channel)
+    // logs can be far larger than what is sensible to hold in a text edit, 
+    // only the chosen page is read from the log files
+    auto currentLog = [js, cb_channel]()
     {
-      te_js_term_out->clear();
-      if (str_channel == str_stdout) {
-        te_js_term_out->setPlainText(js->terminalOutput(QProcess::StandardOutput));
-      } else if (str_channel == str_stderr) {
-        te_js_term_out->setPlainText(js->terminalOutput(QProcess::StandardError));
-      } else {
-        qWarning() << tr("Channel %1 not recognized").arg(str_channel);
-      }
+      return js->terminalLog(static_cast<QProcess::ProcessChannel>(
+            cb_channel->currentData().toInt()));
+    };
+    auto showPage = [currentLog, te_js_term_out](int page)
+    {
+      LogCapture *log = currentLog();
+      te_js_term_out->setPlainText(log != nullptr ? log->page(page-1) : QString());
+    };
+    auto showLastPage = [this, js, currentLog, sb_page, showPage]()
+    {
+      // logs of jobs imported from archives are decompressed once shown
+      for (QProcess::ProcessChannel channel : {QProcess::StandardOutput, QProcess::StandardError})
+        if (js->terminalLog(channel) != nullptr) {
+          extractFromArchive(js->terminalLog(channel)->filePath() + ".1");
+          extractFromArchive(js->terminalLog(channel)->filePath());
+        }
+      LogCapture *log = currentLog();
+      int page_count = qMax(1, log != nullptr ? log->pageCount() : 0);
+      sb_page->blockSignals(true);
+      sb_page->setRange(1, page_count);
+      sb_page->setSuffix(tr(" / %1").arg(page_count));
+      sb_page->setValue(page_count);
+      sb_page->blockSignals(false);
+      showPage(page_count);
     };
 
-    connect(cb_channel, &QComboBox::currentTextChanged, showChannelText);
-    showChannelText(cb_channel->currentText());
+    connect(cb_channel, QOverload<int>::of(&QComboBox::currentIndexChanged), showLastPage);
+    connect(sb_page, QOverload<int>::of(&QSpinBox::valueChanged), showPage);
+    connect(pb_refresh, &QPushButton::clicked, showLastPage);
+    show_last_pages.append(showLastPage);
+
+    QHBoxLayout *hl_log_nav = new QHBoxLayout();
+    hl_log_nav->addWidget(cb_channel);
+    hl_log_nav->addStretch();
+    hl_log_nav->addWidget(new QLabel("Page"));
+    hl_log_nav->addWidget(sb_page);
+    hl_log_nav->addWidget(pb_refresh);
 
     QVBoxLayout *vl_js_term_out = new QVBoxLayout();
-    vl_js_term_out->addWidget(cb_channel);
+    vl_js_term_out->addLayout(hl_log_nav);
     vl_js_term_out->addWidget(te_js_term_out);
 
     QWidget *w_js_term_out = new QWidget();
@@ -736,8 +1748,16 @@ QWidget *SimJob::terminalOutputDialog(QWidget *parent, Qt::WindowFlags w_flags)
     sw_job_term_outs->addWidget(w_js_term_out);
   }
 
+  // logs are only read once their step is selected
   connect(lw_job_steps, &QListWidget::currentRowChanged,
-          sw_job_term_outs, &QStackedWidget::setCurrentIndex);
+          [sw_job_term_outs, show_last_pages](int row)
+          {
+            if (row < 0)
+              return;
+            sw_job_term_outs->setCurrentIndex(row);
+            show_last_pages.at(row)();
+          });
+  lw_job_steps->setCurrentRow(0);
 
   // pop-up widget
   QHBoxLayout *hl_job_term_out = new QHBoxLayout();
@@ -765,6 +1785,12 @@ bool SimJob::exportJob(QString out_path)
     msg.exec();
     return false;
   }
+  if (job_export_running) {
+    QMessageBox msg;
+    msg.setText("The SimJob is already being exported.");
+    msg.exec();
+    return false;
+  }
   if (out_path.isNull()) {
     out_path = QFileDialog::getSaveFileName(nullptr, 
         tr("Export SimJob"), name() + ".sqjx.zip");
@@ -781,12 +1807,154 @@ bool SimJob::exportJob(QString out_path)
         js_tmp_dir.absoluteFilePath("runtime_stderr.log"));
   }
 
-  // throw everything to archive
-  zipper::Zipper zipper(out_path.toStdString());
-  zipper.add(job_tmp_dir_path.toStdString());
-  zipper.close();
+  // compress on a worker thread, the progress dialog deletes itself when 
+  // the export is done
+  QProgressDialog *pd_export = new QProgressDialog(
+      tr("Exporting %1...").arg(name()), tr("Cancel"), 0, 100);
+  pd_export->setWindowTitle(tr("Export SimJob"));
+  pd_export->setAttribute(Qt::WA_DeleteOnClose);
+  pd_export->setMinimumDuration(500);
+  connect(pd_export, &QProgressDialog::canceled,
+          this, [this](){job_export_cancelled.storeRelease(1);});
+  connect(this, &SimJob::sig_jobExportProgress,
+          pd_export, &QProgressDialog::setValue);
+  connect(this, &SimJob::sig_jobExportFinished,
+          pd_export, &QProgressDialog::close);
+  pd_export->setValue(0);
+
+  job_export_running = true;
+  job_export_cancelled.storeRelease(0);
+  export_out_path = out_path;
+  QThreadPool::globalInstance()->start(
+      new JobExportTask(this, job_tmp_dir_path, out_path));
+  return true;
+}
 
-  qDebug() << tr("SimJob exported successfully to %1").arg(out_path);
+void SimJob::jobExportProgressed(int percent)
+{
+  emit sig_jobExportProgress(percent);
+}
 
-  return true;
+void SimJob::jobExportFinished(bool successful)
+{
+  // the export task has released the semaphore before this queued call runs
+  job_export_done.acquire();
+  job_export_running = false;
+  if (successful) {
+    qDebug() << tr("SimJob exported successfully to %1").arg(export_out_path);
+  } else if (job_export_cancelled.loadAcquire() != 0) {
+    qDebug() << tr("SimJob export to %1 cancelled").arg(export_out_path);
+  } else {
+    QMessageBox msg;
+    msg.setText(tr("Failed to export the SimJob to %1.").arg(export_out_path));
+    msg.exec();
+  }
+  emit sig_jobExportFinished(successful);
+}
+
+QWidget *SimJob::sweepResultsDialog(QWidget *parent, Qt::WindowFlags w_flags)
+{
+  QWidget *w_sweep_results = new QWidget(parent, w_flags);
+  w_sweep_results->setAttribute(Qt::WA_DeleteOnClose);
+
+  QStringList headers = sweep_keys;
+  headers << "Ground state energy" << "Charge configuration";
+  QTableWidget *tw_results = new QTableWidget(job_steps.length(), headers.length());
+  tw_results->setHorizontalHeaderLabels(headers);
+  tw_results->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+  // the ground state is the lowest energy physically valid configuration, 
+  // or the lowest energy configuration if the plugin doesn't report validity
+  auto setGroundStateItems = [this, tw_results](int row)
+  {
+    JobStep *js = job_steps.at(row);
+    QString energy_str, config_str;
+    comp::JobResult *result = js->jobResults().value(comp::JobResult::ChargeConfigsResult);
+    if (result != nullptr) {
+      auto configs = static_cast<comp::ChargeConfigSet*>(result)->chargeConfigs();
+      int gs_ind = -1;
+      for (int i=0; i<configs.length(); i++) {
+        if (configs[i].is_valid == 0)
+          continue;
+        if (gs_ind == -1 || configs[i].is_valid > configs[gs_ind].is_valid
+            || (configs[i].is_valid == configs[gs_ind].is_valid
+              && configs[i].energy < configs[gs_ind].energy))
+          gs_ind = i;
+      }
+      if (gs_ind != -1) {
+        energy_str = QString::number(configs[gs_ind].energy, 'g', 8);
+        for (int charge : configs[gs_ind].config)
+          config_str += (charge == 1) ? "-" : ((charge == -1) ? "+" : "0");
+      }
+    }
+    if (energy_str.isEmpty())
+      energy_str = js->loadingResults() ? tr("Loading...")
+        : QMetaEnum::fromType<JobStep::JobStepState>().valueToKey(js->jobStepState());
+    tw_results->setItem(row, sweep_keys.length(), new QTableWidgetItem(energy_str));
+    tw_results->setItem(row, sweep_keys.length()+1, new QTableWidgetItem(config_str));
+  };
+
+  // rows of steps whose results are read on a worker thread are filled in 
+  // once they arrive
+  connect(this, &SimJob::sig_stepResultsLoaded, w_sweep_results,
+          [this, tw_results, setGroundStateItems](JobStep *js)
+          {
+            int row = job_steps.indexOf(js);
+            if (row == -1)
+              return;
+            setGroundStateItems(row);
+            tw_results->resizeColumnsToContents();
+          });
+
+  for (int row=0; row<job_steps.length(); row++) {
+    JobStep *js = job_steps.at(row);
+    for (int col=0; col<sweep_keys.length(); col++)
+      tw_results->setItem(row, col,
+          new QTableWidgetItem(js->jobParameters().value(sweep_keys.at(col))));
+    holdStepResults(js, "sweep_results");
+    setGroundStateItems(row);
+  }
+  releaseStepResults("sweep_results");
+  tw_results->resizeColumnsToContents();
+
+  QPushButton *pb_export_csv = new QPushButton("Export CSV");
+  QPushButton *pb_close = new QPushButton("Close");
+  QDialogButtonBox *dbb_buttons = new QDialogButtonBox();
+  dbb_buttons->addButton(pb_export_csv, QDialogButtonBox::ActionRole);
+  dbb_buttons->addButton(pb_close, QDialogButtonBox::RejectRole);
+
+  connect(pb_close, &QPushButton::clicked, w_sweep_results, &QWidget::close);
+  connect(pb_export_csv, &QPushButton::clicked,
+          [this, tw_results]()
+          {
+            QString csv_path = QFileDialog::getSaveFileName(nullptr,
+                tr("Export Sweep Results"), name() + "_sweep.csv");
+            if (csv_path.isEmpty())
+              return;
+            QFile file(csv_path);
+            if (!file.open(QFile::WriteOnly | QFile::Text)) {
+              qWarning() << tr("Failed to open file to write: %1").arg(csv_path);
+              return;
+            }
+            QTextStream ts(&file);
+            QStringList fields;
+            for (int col=0; col<tw_results->columnCount(); col++)
+              fields << tw_results->horizontalHeaderItem(col)->text();
+            ts << fields.join(",") << "\n";
+            for (int row=0; row<tw_results->rowCount(); row++) {
+              fields.clear();
+              for (int col=0; col<tw_results->columnCount(); col++)
+                fields << tw_results->item(row, col)->text();
+              ts << fields.join(",") << "\n";
+            }
+            file.close();
+          });
+
+  QVBoxLayout *vl_sweep_results = new QVBoxLayout();
+  vl_sweep_results->addWidget(tw_results);
+  vl_sweep_results->addWidget(dbb_buttons);
+
+  w_sweep_results->setWindowTitle(tr("%1 Sweep Results").arg(name()));
+  w_sweep_results->setLayout(vl_sweep_results);
+  return w_sweep_results;
 }
@@ -13,6 +13,8 @@
 #include <QtWidgets>
 #include <QtCore>
 #include "plugin_engine.h"
+#include "result_cache.h"
+#include "log_capture.h"
 #include "job_results/job_result_types.h"
 #include "settings/settings.h" // TODO probably need this later
 #include <tuple> //std::tuple for 3+ article data structure, std::get for accessing the tuples
@@ -23,6 +25,11 @@
 namespace comp{
 
   class SimJob;
+  class ResultParseTask;
+  class CacheLookupTask;
+  class CacheStoreTask;
+  class ProblemExportTask;
+  class JobExportTask;
 
   //! A single job step in a job.
   class JobStep : public QObject
@@ -31,9 +38,43 @@ namespace comp{
 
   public:
 
-    enum JobStepState{NotInvoked, Running, FinishedWithError, FinishedNormally};
+    enum JobStepState{NotInvoked, Running, ParsingResults, FinishedWithError, FinishedNormally};
     Q_ENUM(JobStepState);
 
+    //! Runtime statistics reported by the engine in its result file. Negative
+    //! values indicate quantities that the engine did not report.
+    struct EngineStats
+    {
+      double time_elapsed_s=-1;   //!< wall time
+      double cpu_user_s=-1;       //!< user CPU time
+      double cpu_system_s=-1;     //!< system CPU time
+      qint64 peak_rss_kb=-1;      //!< peak resident set size
+      QList<QPair<QString, double>> phase_times;  //!< seconds spent in each named phase
+    };
+
+    //! Resources used by the plugin process, sampled from /proc/<pid> every
+    //! usage_sample_ms while it runs. The samples miss the last interval 
+    //! before exit, so the CPU times and peak RSS are raised to the engine 
+    //! statistics once the result file has been parsed. Negative values 
+    //! indicate quantities that weren't measured, e.g. on platforms other 
+    //! than Linux or for results restored from the result cache.
+    struct ResourceUsage
+    {
+      double cpu_user_s=-1;       //!< user CPU time including waited-for children
+      double cpu_system_s=-1;     //!< system CPU time including waited-for children
+      qint64 peak_rss_kb=-1;      //!< peak resident set size
+      qint64 read_bytes=-1;       //!< bytes read through read syscalls
+      qint64 written_bytes=-1;    //!< bytes written through write syscalls
+    };
+
+    //! Job results and engine statistics parsed from a result file.
+    struct ParsedResults
+    {
+      QMap<comp::JobResult::ResultType, comp::JobResult*> job_results;
+      EngineStats eng_stats;
+      bool success=false;   //!< the file was read without errors
+    };
+
     //! Constructor.
     JobStep(PluginEngine *t_engine, QStringList t_command_format, 
             gui::PropertyMap t_job_prop_map);
@@ -60,16 +101,25 @@ namespace comp{
     //! Invoke the job step binary and return whether the process set-up 
     //! procedure was successful. Cannot be invoked if confirmJobStepsPlacement()
     //! has not been called or was unsuccessful in the parent sim job.
+    //! If the result cache holds the result of an identical step, the result 
+    //! is restored instead and completion is signalled from the event loop.
     //! Returns whether the binary has been invoked successfully.
     bool invokeBinary();
 
     //! Process the job finish signal.
     void processJobStepCompletion(int t_exit_code, QProcess::ExitStatus t_exit_status);
 
-    //! Read job step results.
-    bool readResults(bool attempt_import_logs=false);
+    //! Read job step results on the calling thread. Repeated charge 
+    //! configuration and potential sections are merged and results of 
+    //! truncated files are kept.
+    bool readResults();
+
+    //! Parse the result file at result_path. Safe to call from any thread, 
+    //! the returned job results have no parent and live in the calling thread.
+    static ParsedResults parseResultFile(const QString &result_path);
 
-    //! Write the terminal outputs to files.
+    //! Write the terminal outputs to files, the captured logs are flushed if 
+    //! the paths are those of the logs themselves.
     void exportTerminalOutputs(QString std_out_path, QString std_err_path);
 
     //! Kill job step
@@ -98,32 +148,114 @@ namespace comp{
     //! Return the end time.
     QDateTime endTime() {return end_time;}
 
-    //! Return the terminal output from the specified channel.
-    QString terminalOutput(QProcess::ProcessChannel channel)
+    //! Return the terminal output log of the specified channel, or a null 
+    //! pointer if the job step directory hasn't been set up.
+    LogCapture *terminalLog(QProcess::ProcessChannel channel)
     {
-      switch (channel) {
-        case QProcess::StandardOutput:
-          return std_out;
-        case QProcess::StandardError:
-          return std_err;
-        default:
-          return std_out;
-      }
+      return (channel == QProcess::StandardError) ? stderr_log : stdout_log;
     }
 
     //! Return the job results.
     QMap <comp::JobResult::ResultType, comp::JobResult*> jobResults() {return job_results;}
 
+    //! Return whether results have been read, possibly partially.
+    bool resultsLoaded() const {return results_read || !job_results.isEmpty();}
+
+    //! Delete the job results, they can be read again with readResults().
+    void releaseResults();
+
+    //! Read the results on a worker thread if they haven't been read, 
+    //! decompressing the files of this step from the archive of archive_job
+    //! first if given. sig_jobStepResultsLoaded is emitted once the results
+    //! have been taken over.
+    void loadResultsInBackground(SimJob *archive_job=nullptr);
+
+    //! Return whether loadResultsInBackground() is reading the results.
+    bool loadingResults() const {return loading_results;}
+
+    //! Return the result types of this step, which are known without loading
+    //! the results if they were recorded in the imported manifest.
+    QList<comp::JobResult::ResultType> resultTypes() const {return result_types;}
+
+    //! Return whether the result types are known.
+    bool resultTypesKnown() const {return result_types_known;}
+
+    //! Return the runtime statistics reported by the engine.
+    EngineStats engineStats() const {return eng_stats;}
+
+    //! Return the resources used by the plugin process.
+    ResourceUsage resourceUsage() const {return res_usage;}
+
     //! Return the job step tmp directory path.
     QString jobStepTempDirPath() const {return js_tmp_dir_path;}
 
+    //! Set whether this step may restore and store results in the result cache.
+    void setUseResultCache(bool use) {use_result_cache = use;}
+
+    //! Return whether the results of this step were restored from the cache.
+    bool resultFromCache() const {return result_from_cache;}
+
+    //! Return the run state of this job step.
+    JobStepState jobStepState() const {return job_step_state;}
+
+    //! Declare the placements of the job steps that must finish normally 
+    //! before this step can be invoked. Steps without declared dependencies 
+    //! depend on the step placed right before them.
+    void setDependencies(const QList<int> &deps) {step_deps = deps; deps_declared = true;}
+
+    //! Return whether dependencies have been declared for this step.
+    bool dependenciesDeclared() const {return deps_declared;}
+
+    //! Return the declared dependencies of this step.
+    QList<int> dependencies() const {return step_deps;}
+
   signals:
 
     //! Emit job step completion status.
     void sig_jobStepFinishState(int placement, bool successful);
 
+    //! Emitted when the process has exited and the results are being parsed 
+    //! on a worker thread, sig_jobStepFinishState follows once they are ready.
+    void sig_jobStepParsingResults(int placement);
+
+    //! Emitted once results requested by loadResultsInBackground() have been
+    //! taken over.
+    void sig_jobStepResultsLoaded(int placement);
+
+  private slots:
+
+    //! Take over the results parsed by the parse task and finish the step.
+    void resultsParsed();
+
+    //! Complete the step from the cache if the lookup task restored its 
+    //! result, start the process otherwise.
+    void cacheLookedUp(QString key, bool restored);
+
   private:
 
+    friend class ResultParseTask;
+    friend class CacheLookupTask;
+
+    //! Start the plugin process and return whether it started.
+    bool startProcess();
+
+    //! Take ownership of the parsed job results and engine statistics.
+    void adoptParsedResults(ParsedResults &parsed);
+
+    //! Set the final state, cache the results if successful and inform the 
+    //! parent job.
+    void finishJobStep(bool successful);
+
+    //! Update res_usage from /proc/<pid> of the running process.
+    void sampleResourceUsage();
+
+    //! Raise the sampled res_usage to the totals reported by the engine.
+    void mergeEngineStats();
+
+    //! Create the terminal output logs in the job step directory if they 
+    //! haven't been created.
+    void initTerminalLogs();
+
     //! Perform keyword replacement on the command and returns whether 
     //! the replacement took place.
     //! TODO implement some sort of "path role" which determines which types of
@@ -134,6 +266,8 @@ namespace comp{
     PluginEngine *engine;
     QStringList command_format;
     QMap<QString, QString> job_params;
+    QList<int> step_deps;                   // placements of steps that must finish before this one
+    bool deps_declared=false;               // step_deps has been set, otherwise depend on the previous step
 
     // pre-invocation variables
     int placement=-1;                       // execution order of this step within the job
@@ -148,14 +282,32 @@ namespace comp{
     // post-invocation, runtime-related variables
     QDateTime start_time;                   // start time of this job step
     QDateTime end_time;                     // end time of this job step
-    QString std_out;                        // stdout from process
-    QString std_err;                        // stderr from process
+    LogCapture *stdout_log=nullptr;         // stdout from process
+    LogCapture *stderr_log=nullptr;         // stderr from process
     int exit_code=-1;                       // exit code of the process, -1 if haven't invoked nor finished
+    bool exit_successful=false;             // the process exited normally with code 0
     QProcess::ExitStatus exit_status;       // exit status of the process (normal or crashed)
+    QTimer *usage_timer=nullptr;            // samples res_usage while the process runs
+    ResourceUsage res_usage;                // resources used by the process
+    static const int usage_sample_ms=500;   // resource usage sampling interval
+
+    // result cache
+    bool use_result_cache=true;             // restore and store results in the result cache
+    bool result_from_cache=false;           // results were restored from the cache
+    QString cache_key;                      // result cache key, empty if not computed
+    bool cache_lookup_pending=false;        // the cache lookup task hasn't handed back yet
+    QSemaphore cache_done;                  // released by the cache lookup task after posting
+    bool terminate_requested=false;         // terminateJobStep() has been called
 
     // post-invocation, results-related variables
     bool results_read=false;                // indicates whether results have been read
+    EngineStats eng_stats;                  // runtime statistics reported by the engine
+    ParsedResults pending_results;          // results handed over by the parse task
+    bool loading_results=false;             // the parse task is loading results on demand
+    QSemaphore parse_done;                  // released by the parse task after handing over results
     QMap<comp::JobResult::ResultType, comp::JobResult*> job_results;  // store job results
+    QList<comp::JobResult::ResultType> result_types;  // types of job results, kept when results are released
+    bool result_types_known=false;          // result_types has been set from results or the manifest
   };
 
 
@@ -175,6 +327,8 @@ namespace comp{
         pb_job_terminal = new QPushButton("Log");
         pb_sim_visualize = new QPushButton("Visualize Results");
         pb_export_results = new QPushButton("Export Results");
+        pb_sweep_results = new QPushButton("Sweep Results");
+        pb_sweep_results->setEnabled(false);
 
         connect(pb_job_terminal, &QPushButton::clicked,
                 [job](){job->terminalOutputDialog()->show();});
@@ -192,6 +346,8 @@ namespace comp{
                 [job](){emit job->sig_requestJobVisualization(job);});
         connect(pb_export_results, &QPushButton::clicked,
                 [job](){job->exportJob();});
+        connect(pb_sweep_results, &QPushButton::clicked,
+                [job](){job->sweepResultsDialog()->show();});
       }
 
       SimJob *job=nullptr;
@@ -199,9 +355,17 @@ namespace comp{
       QPushButton *pb_job_terminal=nullptr;
       QPushButton *pb_sim_visualize=nullptr;
       QPushButton *pb_export_results=nullptr;
+      QPushButton *pb_sweep_results=nullptr;
+    };
+
+    //! A runtime parameter varied by a parameter sweep and the values it takes.
+    struct SweepParameter
+    {
+      QString key;
+      QStringList values;
     };
 
-    enum JobState{NotInvoked, Running, FinishedWithError, FinishedNormally};
+    enum JobState{NotInvoked, Queued, Running, FinishedWithError, FinishedNormally};
     Q_ENUM(JobState);
 
     enum JobInfoStandardItemField{JobNameField, JobStartTimeField, 
@@ -214,6 +378,9 @@ namespace comp{
     //! XML import constructor.
     //! If dcmp is true, then assume that fpath is an archive; if dcmp is false,
     //! then assume that fpath is the manifest XML path.
+    //! Archives are imported lazily: only the manifest is read from the 
+    //! archive and the files of each job step are decompressed when its 
+    //! results are loaded through holdStepResults().
     //! For name_override, use string @IMPORTED_NAME@ to denote the original
     //! name in the manifest. For example, you can provide:
     //! "IMPORTED_@IMPORTED_NAME@"
@@ -235,6 +402,58 @@ namespace comp{
     //! Return a pointer to the list of all job steps.
     QList<JobStep*> jobSteps() {return job_steps;}
 
+    //! Load the results of the job step if they aren't loaded, decompressing
+    //! its files first if the job was imported from an archive, and hold 
+    //! them for holder until holder holds another step or releases them. 
+    //! Results loaded this way that nobody holds are released, least recently
+    //! used first, beyond plugs/max_loaded_job_steps steps. Returns whether
+    //! the results are available now, otherwise they are read on a worker 
+    //! thread and sig_stepResultsLoaded is emitted once they are.
+    bool holdStepResults(JobStep *js, const QString &holder);
+
+    //! Stop holding job step results for holder.
+    void releaseStepResults(const QString &holder) {result_holders.remove(holder);}
+
+    //! Decompress the files of the job step whose paths start with path if 
+    //! the job was imported from an archive. Returns whether all of them 
+    //! were decompressed.
+    bool extractFromArchive(const QString &path);
+
+    //! Parse a parameter sweep specification containing one "key = values" 
+    //! line per swept parameter, where values is either a comma separated 
+    //! list or "start:stop:count" for count evenly spaced values from start 
+    //! to stop inclusive. Keys must exist in prop_map and values must suit 
+    //! the property types. Returns an empty list and sets err_msg on failure.
+    static QList<SweepParameter> parseSweepSpec(const QString &spec,
+        const gui::PropertyMap &prop_map, QString *err_msg=nullptr);
+
+    //! Turn this job into a parameter sweep by adding one job step for each 
+    //! combination of the sweep values (their cartesian product), all other 
+    //! parameters being taken from prop_map. Sweep steps have no dependencies 
+    //! on each other.
+    void addSweepSteps(PluginEngine *engine, const QStringList &command_format,
+        const gui::PropertyMap &prop_map, const QList<SweepParameter> &sweep);
+
+    //! Return whether this job is a parameter sweep.
+    bool isSweep() const {return !sweep_keys.isEmpty();}
+
+    //! Return the keys of the swept parameters.
+    QStringList sweepKeys() const {return sweep_keys;}
+
+    //! Return the placements of the steps that the step at index i depends on,
+    //! the previous step unless dependencies have been declared.
+    QList<int> stepDependencies(int i) const;
+
+    //! Return the largest number of steps that can run at the same time 
+    //! given the step dependencies.
+    int maxParallelSteps() const;
+
+    //! Set the number of job steps that may run at the same time.
+    void setMaxConcurrentSteps(int n) {max_concurrent_steps = qMax(1, n);}
+
+    //! Return the number of job steps that may run at the same time.
+    int maxConcurrentSteps() const {return max_concurrent_steps;}
+
     //! Write the manifest of this job step to the default file location.
     void writeManifest(QString fpath="");
 
@@ -246,12 +465,28 @@ namespace comp{
     //! Set the inclusion area.
     void setInclusionArea(gui::DesignInclusionArea a) {inclusion_area = a;}
 
+    //! Set whether the job steps added so far should bypass the result cache.
+    void setBypassResultCache(bool bypass)
+    {
+      for (JobStep *js : job_steps)
+        js->setUseResultCache(!bypass);
+    }
+
     //! Return the inclusion area.
     gui::DesignInclusionArea inclusionArea() {return inclusion_area;}
 
 
     // JOB EXECUTION
 
+    //! Mark the job as waiting in the JobManager queue for enough free cores 
+    //! to begin.
+    void queueJob();
+
+    //! Return the number of cores this job occupies while running, which is 
+    //! the largest core weight among the engines of its steps multiplied by 
+    //! maxConcurrentSteps().
+    int coreWeight() const;
+
     //! Confirm the job steps order placement, must be done before execution 
     //! begins (beginJob() does this if it hasn't already been done elsewhere).
     void confirmJobStepsPlacement();
@@ -259,16 +494,31 @@ namespace comp{
     //! Prepare the job and contained job steps for invocation.
     void prepareJob();
 
-    //! Begin execution sequence - the first job step would be invoked, 
-    //! appropriate signals connected and at the end of each job step the next 
-    //! one would be invoked. Returns whether the job has begun execution.
+    //! Begin execution - the problem files are requested through 
+    //! sig_exportJobProblems and once they have been exported the job steps 
+    //! without pending dependencies are invoked. Whenever a job step finishes
+    //! the steps that became ready are invoked. Returns whether the job has 
+    //! begun execution, export failures finish the job with error later.
     bool beginJob();
 
-    //! Continue the job if previous step was successful, stop it otherwise.
+    //! Write the problem files of all job steps on a QThreadPool thread from
+    //! design_snapshot, the design panel content within the inclusion area 
+    //! serialized as XML. Steps with identical job parameters share a problem
+    //! file through hard links. problemsExported() is called on completion.
+    void exportProblems(const QByteArray &design_snapshot);
+
+    //! Invoke the ready job steps once the problem files have been exported,
+    //! or finish the job with error if the export failed or the job was 
+    //! terminated in the meantime.
+    Q_INVOKABLE void problemsExported(bool successful);
+
+    //! Record the results of the finished step and invoke the steps that it
+    //! made ready. Steps depending on a failed step are never invoked and the
+    //! job finishes with error once nothing else is running.
     void continueJob(int prev_step_ind, bool prev_step_successful);
 
-    //! Terminal the running job step process and prevent remaining job steps 
-    //! from executing.
+    //! Terminate the running job step processes and prevent remaining job 
+    //! steps from executing. Queued jobs are cancelled without being invoked.
     void terminateJob();
 
     //! Job finish actions.
@@ -314,8 +564,16 @@ namespace comp{
     //! Return the overall start time of the job (start time of the first step).
     QDateTime startTime() const {return job_steps.first()->startTime();}
 
-    //! Return the overall end time of the job (end time of the last step).
-    QDateTime endTime() const {return job_steps.last()->endTime();}
+    //! Return the overall end time of the job (latest end time among the steps
+    //! as steps may run concurrently).
+    QDateTime endTime() const
+    {
+      QDateTime t_end;
+      for (JobStep *js : job_steps)
+        if (js->endTime().isValid() && (!t_end.isValid() || js->endTime() > t_end))
+          t_end = js->endTime();
+      return t_end;
+    }
 
     //! Return the current job state.
     JobState jobState() const {return job_state;}
@@ -330,15 +588,23 @@ namespace comp{
     //! Show a dialog containing the job's terminal output.
     QWidget *terminalOutputDialog(QWidget *parent=nullptr, Qt::WindowFlags w_flags=Qt::Dialog);
 
-    //! Export the finished SimJob into an archive and return whether the export 
-    //! was successful.
+    //! Export the finished SimJob into an archive on a QThreadPool thread, 
+    //! showing its progress in a dialog from which it can be cancelled. 
+    //! Returns whether the export has begun, sig_jobExportFinished is emitted
+    //! once it is done.
     bool exportJob(QString outpath=QString());
 
+    //! Show a dialog tabulating the swept parameters of each sweep step 
+    //! against the energy and charge configuration of its ground state, 
+    //! which can be exported to CSV.
+    QWidget *sweepResultsDialog(QWidget *parent=nullptr, Qt::WindowFlags w_flags=Qt::Dialog);
+
 
   signals:
 
-    //! Export problem files.
-    void sig_exportJobStepProblem(JobStep *job_step, gui::DesignInclusionArea inclusion_area);
+    //! Request a snapshot of the design within the inclusion area to be 
+    //! handed to exportProblems().
+    void sig_exportJobProblems(SimJob *job, gui::DesignInclusionArea inclusion_area);
 
     //! Emit the job finish state.
     void sig_jobFinishState(SimJob *job, JobState finish_state);
@@ -346,9 +612,48 @@ namespace comp{
     //! Request the job results to be shown.
     void sig_requestJobVisualization(SimJob *job);
 
+    //! Emit the percentage of the job archive export that is done.
+    void sig_jobExportProgress(int percent);
+
+    //! Emitted once the job archive export is done or cancelled.
+    void sig_jobExportFinished(bool successful);
+
+    //! Emitted once job step results requested through holdStepResults() 
+    //! have been loaded on a worker thread.
+    void sig_stepResultsLoaded(comp::JobStep *js);
+
 
   private:
 
+    //! Invoke steps whose dependencies have all finished normally while fewer 
+    //! than max_concurrent_steps are running, finishing the job when nothing 
+    //! is running afterwards.
+    void invokeReadySteps();
+
+    //! Show whether any job step is parsing results on the terminate button 
+    //! of a running job.
+    void updateRunningStatus();
+
+    //! Load the job step results on demand, see holdStepResults().
+    bool loadStepResults(JobStep *js);
+
+    //! Map the result types of a step whose results were loaded on demand 
+    //! and relay sig_stepResultsLoaded.
+    void stepResultsLoaded(int placement);
+
+    //! Mark the results of the step as most recently used and release the 
+    //! least recently used ones beyond plugs/max_loaded_job_steps.
+    void touchLoadedStep(JobStep *js);
+
+    //! Relay the progress posted by the job export task.
+    Q_INVOKABLE void jobExportProgressed(int percent);
+
+    //! Wrap up the job archive export once the job export task is done.
+    Q_INVOKABLE void jobExportFinished(bool successful);
+
+    friend class ProblemExportTask;
+    friend class JobExportTask;
+
     // variables
     JobState job_state;                 // the state of the job
     QList<JobStep*> job_steps;          // list of steps in this simulation job, each step invokes one simulation
@@ -358,10 +663,30 @@ namespace comp{
     QString job_name;                   // job name for identification
     QString job_tmp_dir_path;           // job directory for storing runtime data
     QDateTime start_time, end_time;     // start and end times of the job
-    JobStep *curr_step=nullptr;
+    int max_concurrent_steps=1;         // job steps that may run at the same time
+    int running_steps=0;                // job steps currently running
+    bool terminate_requested=false;     // don't invoke further steps
+    bool exporting_problems=false;      // the problem export task hasn't handed back yet
+    QSemaphore export_done;             // released by the problem export task after posting back
+    bool job_export_running=false;      // the job export task hasn't handed back yet
+    QAtomicInt job_export_cancelled;    // set to stop the job export task early
+    QSemaphore job_export_done;         // released by the job export task after posting back
+    QString export_out_path;            // path of the archive being exported
     GuiControlElems gui_ctrl_elems;     // store GUI control elements
     bool imported=false;
 
+    // parameter sweeps
+    QStringList sweep_keys;             // swept parameter keys, empty if this job isn't a sweep
+
+    // lazy import and on-demand results
+    zipper::Unzipper *archive=nullptr;  // archive of a job imported from an archive
+    QString archive_xdir_path;          // directory archive entries are decompressed to
+    QStringList archive_entries;        // file entries in the archive
+    QSet<QString> extracted_entries;    // archive entries that have been decompressed
+    QMutex archive_mutex;               // serializes decompression from the archive
+    QList<JobStep*> loaded_steps;       // steps with results loaded on demand, most recently used last
+    QMap<QString, JobStep*> result_holders;   // steps whose results are held by each holder
+
     // read xml
     QStringList ignored_xml_elements; // XML elements to ignore when reading results
   };
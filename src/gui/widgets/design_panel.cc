@@ -617,6 +617,17 @@ void gui::DesignPanel::writeToXmlStream(QXmlStreamWriter *ws,
   ws->writeEndElement(); // end of design node
 }
 
+QByteArray gui::DesignPanel::designSnapshot(DesignInclusionArea inclusion_area)
+{
+  QByteArray snapshot;
+  QBuffer buf(&snapshot);
+  buf.open(QBuffer::WriteOnly);
+  QXmlStreamWriter ws(&buf);
+  ws.setAutoFormatting(true);
+  writeToXmlStream(&ws, inclusion_area);
+  return snapshot;
+}
+
 void gui::DesignPanel::loadFromFile(QXmlStreamReader *rs, bool is_sim_result)
 {
   if (!is_sim_result) {
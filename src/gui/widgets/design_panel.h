@@ -176,6 +176,10 @@ namespace gui{
     //! Save layers and items into the given write stream.
     void writeToXmlStream(QXmlStreamWriter *, DesignInclusionArea);
 
+    //! Return the layers and items written by writeToXmlStream() as an XML
+    //! fragment, which can be used off the GUI thread.
+    QByteArray designSnapshot(DesignInclusionArea);
+
 
     // LOAD
 
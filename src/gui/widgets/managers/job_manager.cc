@@ -14,6 +14,46 @@ using namespace gui;
 
 typedef comp::PluginEngine PE;
 
+// job view columns before the resource usage columns, the job name followed
+// by the job control buttons
+static const int job_view_usage_col = 6;
+
+// human readable size of the given number of bytes, "-" if negative
+static QString formatBytes(qint64 bytes)
+{
+  if (bytes < 0)
+    return "-";
+  QStringList units({"B", "KiB", "MiB", "GiB", "TiB"});
+  double size = bytes;
+  int unit = 0;
+  while (size >= 1024 && unit < units.length() - 1) {
+    size /= 1024;
+    unit++;
+  }
+  return QString("%1 %2").arg(size, 0, 'f', unit == 0 ? 0 : 1).arg(units[unit]);
+}
+
+// add a sampled quantity to a sum, negative values are unsampled
+template <typename T>
+static void addUsage(T &sum, T val)
+{
+  if (val >= 0)
+    sum = qMax(sum, T(0)) + val;
+}
+
+// resource usage columns of the job view
+static QList<QStandardItem*> resourceUsageItems(const comp::JobStep::ResourceUsage &usage)
+{
+  auto seconds = [](double s) {return s < 0 ? QString("-") : QString("%1 s").arg(s, 0, 'f', 1);};
+  return QList<QStandardItem*>({
+      new QStandardItem(seconds(usage.cpu_user_s)),
+      new QStandardItem(seconds(usage.cpu_system_s)),
+      new QStandardItem(formatBytes(usage.peak_rss_kb < 0 ? -1 : usage.peak_rss_kb * 1024)),
+      new QStandardItem(formatBytes(usage.read_bytes)),
+      new QStandardItem(formatBytes(usage.written_bytes))
+    });
+}
+
 JobManager::JobManager(PluginManager *plugin_manager, SimVisualizer *sim_visualizer,
                        QWidget *parent)
   : QWidget(parent, Qt::Dialog), plugin_manager(plugin_manager),
@@ -36,10 +76,13 @@ void JobManager::addJob(comp::SimJob *job)
     return;
 
   sim_jobs.append(job);
-  connect(job, &comp::SimJob::sig_exportJobStepProblem,
-          this, &gui::JobManager::sig_exportJobProblem);
+  connect(job, &comp::SimJob::sig_exportJobProblems,
+          this, &gui::JobManager::sig_exportJobProblems);
   connect(job, &comp::SimJob::sig_jobFinishState, 
           this, &JobManager::processFinishedJob);
+  for (comp::JobStep *js : job->jobSteps())
+    connect(js, &comp::JobStep::sig_jobStepFinishState,
+            [this, job](){updateJobResourceUsage(job);});
   connect(job, &comp::SimJob::sig_requestJobVisualization,
           [this, job]()
           {
@@ -55,12 +98,14 @@ void JobManager::addJob(comp::SimJob *job)
   QList<QStandardItem*> row_job_info;
   row_job_info.append(new QStandardItem(job->name()));
   job_view_model->insertRow(0, row_job_info); // prepend row
+  job_view_items.insert(job, row_job_info.first());
 
   QList<QWidget*> row_widgets({
         job->guiControlElems().pb_terminate,
         job->guiControlElems().pb_sim_visualize,
         job->guiControlElems().pb_job_terminal,
-        job->guiControlElems().pb_export_results
+        job->guiControlElems().pb_export_results,
+        job->guiControlElems().pb_sweep_results
       });
 
   tv_job_view->resizeColumnToContents(0);
@@ -71,12 +116,26 @@ void JobManager::addJob(comp::SimJob *job)
           col), row_widgets[col-col_start]);
     tv_job_view->resizeColumnToContents(col);
   }
+  updateJobResourceUsage(job);
+  updateJobCounts();
 }
 
 void JobManager::runJob(comp::SimJob *job)
 {
   addJob(job);
-  job->beginJob();
+  // run as many independent job steps at once as the core budget allows
+  int step_weight = job->coreWeight() / job->maxConcurrentSteps();
+  job->setMaxConcurrentSteps(qMin(job->maxParallelSteps(),
+        coreBudget() / step_weight));
+  job->queueJob();
+  job_queue.append(job);
+  scheduleJobs();
+}
+
+int JobManager::coreBudget() const
+{
+  int max_cores = settings::AppSettings::instance()->get<int>("plugs/max_cores");
+  return max_cores > 0 ? max_cores : qMax(1, QThread::idealThreadCount());
 }
 
 void JobManager::processFinishedJob(comp::SimJob *job, comp::SimJob::JobState)
@@ -84,8 +143,14 @@ void JobManager::processFinishedJob(comp::SimJob *job, comp::SimJob::JobState)
   // TODO if successful, check that result files are all successfully read (add
   // a flag in job steps to facilitate this)
 
-  // update GUI elements in job manager
+  // free the cores of the job and begin waiting jobs, cancelled jobs are 
+  // still in the queue
+  job_queue.removeAll(job);
+  cores_in_use -= job_cores.take(job);
+  scheduleJobs();
 
+  // update GUI elements in job manager
+  updateJobCounts();
 
   // execute SQCommands if any is available
   // TODO allow users to make execution manual and prompt user before execution
@@ -490,29 +555,73 @@ QWidget *JobManager::initJobSetupPanel()
             // create sim job and submit to application
             comp::SimJob *new_job = new comp::SimJob(job_details.name, nullptr);
             new_job->setInclusionArea(job_details.inclusion_area);
+            auto abortJob = [this, new_job](const QString &msg_text)
+            {
+              delete new_job;
+              QMessageBox *msg = new QMessageBox(this);
+              msg->setAttribute(Qt::WA_DeleteOnClose);
+              msg->setText(msg_text);
+              msg->open();
+            };
+            QMap<int, int> row_placements;  // job step list rows to step placements
             for (int i=0; i<job_steps_model->rowCount(); i++) {
               QStandardItem *si_job_step = job_steps_model->item(i);
               EngineDataset *eng_dataset = static_cast<JobStepViewListItem*>(si_job_step)->eng_dataset;
               if (eng_dataset == nullptr || eng_dataset->isEmpty()) {
                 continue;
               } else if (!eng_dataset->engine->readyToUse()) {
-                delete new_job;
-
-                QMessageBox *msg = new QMessageBox(this);
-                msg->setAttribute(Qt::WA_DeleteOnClose);
-                msg->setText(tr("Plugin %1 is not ready to use, aborting job. "
+                abortJob(tr("Plugin %1 is not ready to use, aborting job. "
                       "You may check the plugin status under Tools -> Plugin "
                       "Manager.")
                     .arg(eng_dataset->engine->name()));
-                msg->open();
-
                 return;
+              } else if (!eng_dataset->sweep_spec.trimmed().isEmpty()) {
+                // a sweep fans a single step out into one step per parameter 
+                // combination
+                if (job_steps_model->rowCount() != 1) {
+                  abortJob(tr("Parameter sweeps are only supported for jobs "
+                        "with a single job step, aborting job."));
+                  return;
+                }
+                QString err_msg;
+                gui::PropertyMap prop_map = eng_dataset->prop_form->finalProperties();
+                auto sweep = comp::SimJob::parseSweepSpec(eng_dataset->sweep_spec,
+                    prop_map, &err_msg);
+                if (sweep.isEmpty()) {
+                  abortJob(tr("Invalid parameter sweep, aborting job. %1").arg(err_msg));
+                  return;
+                }
+                new_job->addSweepSteps(eng_dataset->engine,
+                    eng_dataset->command_format.split("\n"), prop_map, sweep);
+                continue;
               }
               // create a sim job step and add it to the job
-              new_job->addJobStep(new comp::JobStep(eng_dataset->engine,
+              comp::JobStep *job_step = new comp::JobStep(eng_dataset->engine,
                                                     eng_dataset->command_format.split("\n"),
-                                                    eng_dataset->prop_form->finalProperties()));
+                                                    eng_dataset->prop_form->finalProperties());
+              // dependencies are given as step numbers in the job step list
+              QString deps_spec = eng_dataset->depends_spec.trimmed();
+              if (deps_spec.compare("none", Qt::CaseInsensitive) == 0) {
+                job_step->setDependencies(QList<int>());
+              } else if (!deps_spec.isEmpty()) {
+                QList<int> deps;
+                for (const QString &dep_str : deps_spec.split(",", QString::SkipEmptyParts)) {
+                  bool ok;
+                  int dep_row = dep_str.trimmed().toInt(&ok) - 1;
+                  if (!ok || !row_placements.contains(dep_row)) {
+                    delete job_step;
+                    abortJob(tr("Job step %1 can only depend on job steps "
+                          "listed before it, aborting job.").arg(i+1));
+                    return;
+                  }
+                  deps.append(row_placements.value(dep_row));
+                }
+                job_step->setDependencies(deps);
+              }
+              row_placements.insert(i, new_job->jobSteps().length());
+              new_job->addJobStep(job_step);
             }
+            new_job->setBypassResultCache(job_details.bypass_cache);
             runJob(new_job);
           });
 
@@ -541,7 +650,9 @@ QWidget *JobManager::initJobSetupPanel()
 QWidget *JobManager::initJobViewPanel()
 {
   job_view_model = new QStandardItemModel();
-  job_view_model->setColumnCount(5);  // TODO make dynamic
+  job_view_model->setColumnCount(job_view_usage_col + 5);  // TODO make dynamic
+  job_view_model->setHorizontalHeaderLabels({"Job", "", "", "", "", "",
+      "CPU User", "CPU System", "Peak RSS", "Read", "Written"});
   tv_job_view = new QTreeView();
   tv_job_view->header()->setStretchLastSection(false);
   tv_job_view->setModel(job_view_model);
@@ -551,12 +662,17 @@ QWidget *JobManager::initJobViewPanel()
 
   QPushButton *pb_close = new QPushButton("Close", this);
   QPushButton *pb_import_job_results = new QPushButton("Import Past Results", this);
+  QPushButton *pb_clear_cache = new QPushButton("Clear Result Cache", this);
   pb_close->setShortcut(Qt::Key_Escape);
   QDialogButtonBox *dbb_job_view_buttons = new QDialogButtonBox();
   dbb_job_view_buttons->addButton(pb_close, QDialogButtonBox::RejectRole);
   dbb_job_view_buttons->addButton(pb_import_job_results, QDialogButtonBox::ActionRole);
+  dbb_job_view_buttons->addButton(pb_clear_cache, QDialogButtonBox::ActionRole);
+
+  l_job_counts = new QLabel();
 
   vl_job_view = new QVBoxLayout();
+  vl_job_view->addWidget(l_job_counts);
   vl_job_view->addWidget(tv_job_view);
   vl_job_view->addWidget(dbb_job_view_buttons);
 
@@ -574,10 +690,66 @@ QWidget *JobManager::initJobViewPanel()
         }
       });
 
+  connect(pb_clear_cache, &QPushButton::clicked,
+      [](){comp::ResultCache::instance()->clear();});
+
+  updateJobCounts();
+
   //return tv_job_view;
   return vl_job_view_widget;
 }
 
+void JobManager::scheduleJobs()
+{
+  // jobs that fail to begin finish right away and call back into this
+  if (scheduling)
+    return;
+  scheduling = true;
+
+  int budget = coreBudget();
+  while (!job_queue.isEmpty()) {
+    comp::SimJob *job = job_queue.first();
+    int weight = job->coreWeight();
+    if (cores_in_use + weight > budget && !job_cores.isEmpty())
+      break;
+    job_queue.removeFirst();
+    job_cores.insert(job, weight);
+    cores_in_use += weight;
+    qDebug() << tr("Beginning job %1 using %2 of %3 cores")
+      .arg(job->name()).arg(cores_in_use).arg(budget);
+    job->beginJob();
+  }
+
+  scheduling = false;
+  updateJobCounts();
+}
+
+void JobManager::updateJobCounts()
+{
+  int queued=0, running=0, finished=0;
+  for (comp::SimJob *job : sim_jobs) {
+    switch (job->jobState()) {
+      case comp::SimJob::Queued:
+        queued++;
+        break;
+      case comp::SimJob::Running:
+        running++;
+        break;
+      case comp::SimJob::FinishedNormally:
+      case comp::SimJob::FinishedWithError:
+        finished++;
+        break;
+      default:
+        break;
+    }
+  }
+  comp::ResultCache *cache = comp::ResultCache::instance();
+  l_job_counts->setText(tr("Queued: %1    Running: %2    Finished: %3    "
+        "Cores in use: %4/%5    Cache hits: %6    Cache misses: %7")
+      .arg(queued).arg(running).arg(finished).arg(cores_in_use)
+      .arg(coreBudget()).arg(cache->hits()).arg(cache->misses()));
+}
+
 comp::PluginEngine *JobManager::selectedEngine()
 {
   QModelIndex model_index = lv_engines->currentIndex();
@@ -601,6 +773,7 @@ JobSetupDetailsPane::JobSetupDetailsPane(QWidget *parent)
   QGroupBox *gb_plugin_props = new QGroupBox("Plugin Invocation");
   QGroupBox *gb_plugin_status = new QGroupBox("Plugin Status");
   QGroupBox *gb_plugin_params = new QGroupBox("Plugin Runtime Parameters");
+  QGroupBox *gb_sweep = new QGroupBox("Parameter Sweep");
 
   // Job
   le_job_name = new QLineEdit();
@@ -608,6 +781,9 @@ JobSetupDetailsPane::JobSetupDetailsPane(QWidget *parent)
   QCheckBox *cb_auto_job_name = new QCheckBox("Auto job name");
   cb_auto_job_name->setChecked(true);
   cbb_inclusion_area = new QComboBox();
+  cb_bypass_cache = new QCheckBox("Bypass result cache");
+  cb_bypass_cache->setToolTip("Rerun all job steps even if results of "
+      "identical job steps are in the result cache.");
 
   // response to auto job name checkbox
   auto autoJobNameResponse = [this](int check_state)
@@ -633,6 +809,7 @@ JobSetupDetailsPane::JobSetupDetailsPane(QWidget *parent)
   fl_job_props->addRow(new QLabel("Job name"), le_job_name);
   fl_job_props->addRow(hl_auto_job_name);
   fl_job_props->addRow(new QLabel("Inclusion area"), cbb_inclusion_area);
+  fl_job_props->addRow(cb_bypass_cache);
   fl_job_props->setSizeConstraint(QLayout::SetMinimumSize);
   gb_job_props->setLayout(fl_job_props);
 
@@ -652,11 +829,27 @@ JobSetupDetailsPane::JobSetupDetailsPane(QWidget *parent)
   hl_command->addStretch();
   hl_command->addWidget(tb_command_preset);
 
+  le_depends = new QLineEdit();
+  le_depends->setPlaceholderText("Previous step");
+  le_depends->setToolTip("Comma separated numbers of the job steps that must "
+      "finish before this one runs, or \"none\" to run it right away. Job "
+      "steps without pending dependencies run concurrently.");
+
   QFormLayout *fl_plugin_props = new QFormLayout();
   fl_plugin_props->addRow(hl_command);
   fl_plugin_props->addRow(te_command);
+  fl_plugin_props->addRow(new QLabel("Depends on steps"), le_depends);
   gb_plugin_props->setLayout(fl_plugin_props);
 
+  // update the job step dependencies in engine dataset
+  connect(le_depends, &QLineEdit::textChanged,
+          [this](const QString &text)
+          {
+            if (eng_dataset == nullptr)
+              return;
+            eng_dataset->depends_spec = text;
+          });
+
   // update command format in engine dataset to the newest textedit content
   connect(te_command, &QTextEdit::textChanged,
           [this]()
@@ -689,11 +882,32 @@ JobSetupDetailsPane::JobSetupDetailsPane(QWidget *parent)
   vl_plugin_params = new QVBoxLayout();
   gb_plugin_params->setLayout(vl_plugin_params);
 
+  // Parameter Sweep
+  te_sweep = new QPlainTextEdit();
+  te_sweep->setPlaceholderText("mu = -0.32:-0.25:8\neps_r = 5.6, 6.0");
+  QLabel *l_sweep_help = new QLabel("One \"key = values\" line per swept "
+      "runtime parameter, values being a comma separated list or "
+      "start:stop:count. The job runs once per combination of values.");
+  l_sweep_help->setWordWrap(true);
+  QVBoxLayout *vl_sweep = new QVBoxLayout();
+  vl_sweep->addWidget(l_sweep_help);
+  vl_sweep->addWidget(te_sweep);
+  gb_sweep->setLayout(vl_sweep);
+
+  connect(te_sweep, &QPlainTextEdit::textChanged,
+          [this]()
+          {
+            if (eng_dataset == nullptr)
+              return;
+            eng_dataset->sweep_spec = te_sweep->toPlainText();
+          });
+
   QVBoxLayout *vl_pane = new QVBoxLayout();
   vl_pane->addWidget(gb_job_props);
   vl_pane->addWidget(gb_plugin_props);
   vl_pane->addWidget(gb_plugin_status);
   vl_pane->addWidget(gb_plugin_params);
+  vl_pane->addWidget(gb_sweep);
   vl_pane->addStretch();
   setLayout(vl_pane);
 }
@@ -722,11 +936,15 @@ void JobSetupDetailsPane::setEngineDataset(JobManager::EngineDataset *t_eng_data
   if (eng_dataset == nullptr) {
     // no dataset selected, clear GUI elements
     te_command->setText("");
+    te_sweep->setPlainText("");
+    le_depends->setText("");
     menu_command_preset->clear();
     return;
   }
 
   te_command->setText(eng_dataset->command_format);
+  te_sweep->setPlainText(eng_dataset->sweep_spec);
+  le_depends->setText(eng_dataset->depends_spec);
 
   // update engine command preset menu
   menu_command_preset->clear();
@@ -745,3 +963,35 @@ void JobSetupDetailsPane::setEngineDataset(JobManager::EngineDataset *t_eng_data
   // show new property form
   vl_plugin_params->addWidget(eng_dataset->prop_form);
 }
+
+void JobManager::updateJobResourceUsage(comp::SimJob *job)
+{
+  QStandardItem *job_item = job_view_items.value(job);
+  if (job_item == nullptr)
+    return;
+
+  // one child row per step and the totals in the job row
+  job_item->removeRows(0, job_item->rowCount());
+  comp::JobStep::ResourceUsage total;
+  for (comp::JobStep *js : job->jobSteps()) {
+    comp::JobStep::ResourceUsage usage = js->resourceUsage();
+    addUsage(total.cpu_user_s, usage.cpu_user_s);
+    addUsage(total.cpu_system_s, usage.cpu_system_s);
+    addUsage(total.read_bytes, usage.read_bytes);
+    addUsage(total.written_bytes, usage.written_bytes);
+    total.peak_rss_kb = qMax(total.peak_rss_kb, usage.peak_rss_kb);
+
+    QList<QStandardItem*> step_row({new QStandardItem(tr("Step %1")
+          .arg(js->jobStepPlacement() + 1))});
+    for (int col=1; col<job_view_usage_col; col++)
+      step_row.append(new QStandardItem());
+    step_row.append(resourceUsageItems(usage));
+    job_item->appendRow(step_row);
+  }
+
+  QList<QStandardItem*> total_items = resourceUsageItems(total);
+  for (int i=0; i<total_items.length(); i++)
+    job_view_model->setItem(job_item->row(), job_view_usage_col + i, total_items[i]);
+  for (int col=job_view_usage_col; col<job_view_model->columnCount(); col++)
+    tv_job_view->resizeColumnToContents(col);
+}
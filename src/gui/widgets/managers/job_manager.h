@@ -62,6 +62,9 @@ namespace gui{
       comp::PluginEngine *engine=nullptr;
       QString command_format;           // command format with arguments delimited by "\n".
       PropertyForm *prop_form=nullptr;
+      QString sweep_spec;               // parameter sweep specification, see comp::SimJob::parseSweepSpec
+      QString depends_spec;             // comma separated job step numbers this step depends on, empty for the previous step
+
     };
 
     //! Constructor.
@@ -77,9 +80,14 @@ namespace gui{
     void addJob(comp::SimJob *job);
 
     //! Run the specified job, if the job hasn't already been added to the 
-    //! manager it will be added.
+    //! manager it will be added. The job is queued until enough of the core 
+    //! budget is free for it, see scheduleJobs().
     void runJob(comp::SimJob *job);
 
+    //! Return the number of cores that running jobs may occupy together, set 
+    //! by the plugs/max_cores setting (0 uses all cores of the machine).
+    int coreBudget() const;
+
     //! Process a finished job.
     void processFinishedJob(comp::SimJob *job, comp::SimJob::JobState finish_state);
 
@@ -95,10 +103,9 @@ namespace gui{
 
   signals:
 
-    //! Request application to save a job problem file to the specified path, 
-    //! can be used either in preparation of running a simulation or exporting 
-    //! for future use.
-    void sig_exportJobProblem(comp::JobStep *job_step, gui::DesignInclusionArea inclusion_area);
+    //! Request application to snapshot the design within the inclusion area 
+    //! for the job to write its problem files from.
+    void sig_exportJobProblems(comp::SimJob *job, gui::DesignInclusionArea inclusion_area);
 
     //! Emit a SiQAD command for commander to parse.
     void sig_executeSQCommand(QString command);
@@ -153,10 +160,26 @@ namespace gui{
     //! pointer if none is selected.
     comp::PluginEngine *selectedEngine();
 
+    //! Begin queued jobs in submission order for as long as the next job's 
+    //! core weight fits in the unused core budget. A job heavier than the 
+    //! whole budget is begun once nothing else is running.
+    void scheduleJobs();
+
+    //! Update the queued, running and finished job counts in the job view.
+    void updateJobCounts();
+
+    //! Show the resources used by the job in its job view row, summed over
+    //! its steps (peak RSS is the largest), with a child row for each step.
+    void updateJobResourceUsage(comp::SimJob *job);
+
     PluginManager *plugin_manager;
     SimVisualizer *sim_visualizer;         // pointer to the sim_visualizer
 
     QList<comp::SimJob*> sim_jobs;        // list of all jobs
+    QList<comp::SimJob*> job_queue;       // jobs waiting for cores in submission order
+    QMap<comp::SimJob*, int> job_cores;   // cores occupied by each running job
+    int cores_in_use=0;                   // sum of job_cores
+    bool scheduling=false;                // scheduleJobs() is in progress
     QListView *lv_engines;                // list view of engines in the engine list
     QListView *lv_job_steps;              // list view of job steps
     QVBoxLayout *vl_job_view;             // vertical layout of job view with the tree view and useful buttons
@@ -166,12 +189,14 @@ namespace gui{
     QStandardItemModel *cat_filter_model; // data model storing the filter items used for filtering eng_model
     QStandardItemModel *job_steps_model;  // data model storing the job steps engine sequence
     QStandardItemModel *job_view_model;   // data model storing the list of submitted and completed jobs
+    QMap<comp::SimJob*, QStandardItem*> job_view_items;   // name item of each job in job_view_model
     QList<comp::PluginEngine::StandardItemField> eng_list_fields; // order of fields in eng_model
 
     // GUI elements that need class-wide access
     QListWidget *lw_job_action;           // current main action in JM
     QListWidgetItem *lwi_new_job;         // list item for new job
     QListWidgetItem *lwi_view_jobs;       // list item for viewing jobs
+    QLabel *l_job_counts;                 // queued, running and finished job counts
 
   };
 
@@ -210,6 +235,7 @@ namespace gui{
     {
       QString name;
       gui::DesignInclusionArea inclusion_area;
+      bool bypass_cache;
     };
 
     //! Constructor.
@@ -234,6 +260,7 @@ namespace gui{
       QMetaEnum inc_a_enum = QMetaEnum::fromType<IA>();
       job_details.inclusion_area = static_cast<IA>(inc_a_enum.keyToValue(
             cbb_inclusion_area->currentText().toLatin1()));
+      job_details.bypass_cache = cb_bypass_cache->isChecked();
       return job_details;
     }
     
@@ -243,12 +270,15 @@ namespace gui{
     JobManager::EngineDataset *eng_dataset=nullptr; // currently used engine dataset
     QLineEdit *le_job_name;                         // job name
     QComboBox *cbb_inclusion_area;                  // inclusion area
+    QCheckBox *cb_bypass_cache;                     // rerun job steps even if their results are cached
     QLabel *l_plugin_name;                          // plugin name
     QLabel *l_plugin_status;                        // plugin status
     QPushButton *pb_refresh_status;                 // refresh the plugin status
     QMenu *menu_command_preset;                     // command format preset selection menu
     QTextEdit *te_command;                          // command format edit field
+    QLineEdit *le_depends;                          // job step dependencies edit field
     QVBoxLayout *vl_plugin_params;                  // layout holding engine property form
+    QPlainTextEdit *te_sweep;                       // parameter sweep specification edit field
   };
 
 
@@ -90,6 +90,9 @@ SimVisualizer::SimVisualizer(DesignPanel *design_pan, QWidget *parent)
   {
     comp::JobStep *js = sim_job->getJobStep(job_step_ind);
     charge_config_set_visualizer->clearVisualizer();
+    // results of imported jobs are only loaded once their step is picked, 
+    // they are shown by jobStepResultsLoaded() if they aren't available yet
+    sim_job->holdStepResults(js, "charge_configs");
     emit sig_loadProblemFile(js->problemPath());
     charge_config_set_visualizer->setLattice(design_pan->getLattice(false));
     ECS *charge_config_set = static_cast<ECS*>(
@@ -145,6 +148,8 @@ SimVisualizer::SimVisualizer(DesignPanel *design_pan, QWidget *parent)
   auto setPotentialLandscapeJobStep = [this](const int &job_step_ind)
   {
     comp::JobStep *js = sim_job->getJobStep(job_step_ind);
+    pot_landscape_visualizer->clearVisualizer();
+    sim_job->holdStepResults(js, "pot_landscape");
     emit sig_loadProblemFile(js->problemPath());
     PL *pot_landscape = static_cast<PL*>(
         js->jobResults().value(comp::JobResult::PotentialLandscapeResult));
@@ -199,6 +204,8 @@ void SimVisualizer::showJob(comp::SimJob *job)
   clearJob();
 
   sim_job = job;
+  results_loaded_conn = connect(job, &comp::SimJob::sig_stepResultsLoaded,
+                                this, &SimVisualizer::jobStepResultsLoaded);
   qDebug() << tr("Showing job %1").arg(job->name());
   setEnabled(true);
 
@@ -262,6 +269,7 @@ void SimVisualizer::clearJob()
   charge_config_set_visualizer->clearVisualizer();
   pot_landscape_visualizer->clearVisualizer();
 
+  disconnect(results_loaded_conn);
   sim_job = nullptr;
 
   // disable user interaction to the entire plugin
@@ -271,6 +279,32 @@ void SimVisualizer::clearJob()
   // output dialog button somewhere
 }
 
+void SimVisualizer::jobStepResultsLoaded(comp::JobStep *js)
+{
+  QString str_job_step_ind = QString::number(js->jobStepPlacement());
+  QMap<JR::ResultType, JR*> results = js->jobResults();
+
+  // steps of manifests that predate recording result types only reveal them
+  // now, adding the first step to a selection shows it
+  if (results.contains(JR::ChargeConfigsResult)
+      && cb_job_steps_charge_configs->findText(str_job_step_ind) == -1) {
+    gb_charge_configs->setEnabled(true);
+    cb_job_steps_charge_configs->addItem(str_job_step_ind);
+  } else if (cb_job_steps_charge_configs->currentText() == str_job_step_ind) {
+    charge_config_set_visualizer->setChargeConfigSet(
+        static_cast<ECS*>(results.value(JR::ChargeConfigsResult)));
+  }
+
+  if (results.contains(JR::PotentialLandscapeResult)
+      && cb_job_steps_pot_landscape->findText(str_job_step_ind) == -1) {
+    gb_pot_landscape->setEnabled(true);
+    cb_job_steps_pot_landscape->addItem(str_job_step_ind);
+  } else if (cb_job_steps_pot_landscape->currentText() == str_job_step_ind) {
+    pot_landscape_visualizer->setPotentialLandscape(
+        static_cast<PL*>(results.value(JR::PotentialLandscapeResult)));
+  }
+}
+
 void SimVisualizer::designPanelResetActions()
 {
   charge_config_set_visualizer->setLattice(design_pan->getLattice(false));
@@ -93,8 +93,14 @@ namespace gui{
 
   private:
 
+    //! Show the results of a job step whose results were loaded on a worker
+    //! thread if it is selected, adding it to the step selections if its 
+    //! result types weren't known before.
+    void jobStepResultsLoaded(comp::JobStep *js);
+
     gui::DesignPanel *design_pan;             // pointer to the design panel
     comp::SimJob *sim_job=nullptr;            // current job result being shown
+    QMetaObject::Connection results_loaded_conn;  // sim_job's sig_stepResultsLoaded to this
 
     ChargeConfigSetVisualizer *charge_config_set_visualizer;
     PotentialLandscapeVisualizer *pot_landscape_visualizer;
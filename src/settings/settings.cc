@@ -141,6 +141,10 @@ QSettings *settings::AppSettings::m_defs()
   }));
   S->setValue("plugs/preset_root_path", QString("<CONFIG>/plugins/"));
   S->setValue("plugs/runtime_tmp_root_path", QString("<SYSTMP>/plugins/"));
+  S->setValue("plugs/max_cores", 0);  // core budget of concurrent jobs, 0 for all cores
+  S->setValue("plugs/result_cache_max_mb", 512);  // result cache size cap, 0 disables caching
+  S->setValue("plugs/max_log_mb", 64);  // plugin log file size before rotation
+  S->setValue("plugs/max_loaded_job_steps", 8);  // job steps with results loaded on demand kept in memory
 
   S->setValue("float_prc", 6);  // float precision specified in QString::setNum; not always obeyed.
   S->setValue("float_fmt", "g");   // float format specified in QString::setNum; not always obeyed.
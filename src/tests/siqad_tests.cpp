@@ -2,6 +2,7 @@
 
 #include "gui/widgets/managers/layer_manager.h"
 #include "gui/widgets/primitives/lattice.h"
+#include "gui/widgets/components/sim_job.h"
 
 class SiQADTests: public QObject
 {
@@ -50,6 +51,196 @@ private slots:
     QCOMPARE(layman->layerCount(), 0);
   }
 
+  void testSweepSpec()
+  {
+    gui::PropertyMap prop_map;
+    prop_map.insert("mu", gui::Property(QVariant(-0.25)));
+    prop_map.insert("num_instances", gui::Property(QVariant(10)));
+    prop_map.insert("T_schedule", gui::Property(0, QVariant("exponential"), -1, "", "",
+          gui::ValueSelection(gui::Combo, {gui::ComboOption("exponential", "Exponential"),
+                                           gui::ComboOption("linear", "Linear")}),
+          QMap<QString, QString>()));
+
+    // ranges are evenly spaced from start to stop inclusive
+    QString err_msg;
+    QList<comp::SimJob::SweepParameter> sweep = comp::SimJob::parseSweepSpec(
+        "mu = -0.3:-0.1:3", prop_map, &err_msg);
+    QCOMPARE(sweep.length(), 1);
+    QCOMPARE(sweep[0].key, QString("mu"));
+    QCOMPARE(sweep[0].values, QStringList({"-0.3", "-0.2", "-0.1"}));
+    sweep = comp::SimJob::parseSweepSpec("mu = 0.5:1:1", prop_map);
+    QCOMPARE(sweep[0].values, QStringList({"0.5"}));
+
+    // lists, several parameters and blank lines
+    sweep = comp::SimJob::parseSweepSpec("\n num_instances = 10, 20,30 \n\n"
+        "T_schedule = linear,exponential\n", prop_map);
+    QCOMPARE(sweep.length(), 2);
+    QCOMPARE(sweep[0].key, QString("num_instances"));
+    QCOMPARE(sweep[0].values, QStringList({"10", "20", "30"}));
+    QCOMPARE(sweep[1].key, QString("T_schedule"));
+    QCOMPARE(sweep[1].values, QStringList({"linear", "exponential"}));
+
+    // bad specifications give no sweep and an error message
+    QStringList bad_specs({
+        "",                             // no parameters
+        "mu -0.3",                      // not key = values
+        "unknown = 1",                  // not a parameter
+        "mu = 0.1\nmu = 0.2",           // given twice
+        "mu = ,",                       // no values
+        "mu = a:b:3",                   // range bounds aren't numbers
+        "mu = 0:1:0",                   // range count below 1
+        "mu = 0.1, high",               // value isn't a number
+        "num_instances = 1.5",          // value isn't an int
+        "T_schedule = quadratic"});     // value isn't a combo option
+    for (const QString &spec : bad_specs) {
+      err_msg.clear();
+      sweep = comp::SimJob::parseSweepSpec(spec, prop_map, &err_msg);
+      QVERIFY2(sweep.isEmpty(), qPrintable(spec));
+      QVERIFY2(!err_msg.isEmpty(), qPrintable(spec));
+    }
+  }
+
+  void testMaxParallelSteps()
+  {
+    // build a job whose step i depends on the steps in deps[i]
+    auto maxParallelSteps = [](const QList<QList<int>> &deps)
+    {
+      comp::SimJob job("test");
+      for (const QList<int> &step_deps : deps) {
+        comp::JobStep *js = new comp::JobStep(nullptr, QStringList(), gui::PropertyMap());
+        js->setDependencies(step_deps);
+        job.addJobStep(js);
+      }
+      return job.maxParallelSteps();
+    };
+
+    // chain, each step depending on the previous one
+    QCOMPARE(maxParallelSteps({{}, {0}, {1}, {2}}), 1);
+
+    // diamond, the two middle steps may run together
+    QCOMPARE(maxParallelSteps({{}, {0}, {0}, {1, 2}}), 2);
+
+    // fully independent steps
+    QCOMPARE(maxParallelSteps({{}, {}, {}, {}, {}}), 5);
+
+    // fan out where one branch continues, its second step can overlap the
+    // other branches
+    QCOMPARE(maxParallelSteps({{}, {0}, {0}, {0}, {1}}), 3);
+
+    // steps without declared dependencies depend on the previous step
+    comp::SimJob job("test");
+    for (int i=0; i<3; i++)
+      job.addJobStep(new comp::JobStep(nullptr, QStringList(), gui::PropertyMap()));
+    QCOMPARE(job.maxParallelSteps(), 1);
+    QCOMPARE(comp::SimJob("empty").maxParallelSteps(), 0);
+  }
+
+  void testResultCacheKey()
+  {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto writeProblem = [&dir](const QString &name, const QByteArray &xml)
+    {
+      QFile file(dir.filePath(name));
+      file.open(QFile::WriteOnly);
+      file.write(xml);
+      return file.fileName();
+    };
+
+    QString base = writeProblem("base.xml",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<siqad>\n"
+        "    <program>\n"
+        "        <file_purpose>simulation</file_purpose>\n"
+        "        <version>0.2.2</version>\n"
+        "        <date>2019-05-02 10:00:00</date>\n"
+        "    </program>\n"
+        "    <sim_params>\n"
+        "        <mu>-0.25</mu>\n"
+        "    </sim_params>\n"
+        "    <design>\n"
+        "        <layer type=\"DB\">\n"
+        "            <dbdot>\n"
+        "                <latcoord n=\"1\" m=\"2\" l=\"0\"/>\n"
+        "            </dbdot>\n"
+        "        </layer>\n"
+        "    </design>\n"
+        "</siqad>\n");
+    // same problem with other formatting, saved at another time by another
+    // version
+    QString reformatted = writeProblem("reformatted.xml",
+        "<?xml version=\"1.0\"?>"
+        "<siqad><program><file_purpose>simulation</file_purpose>"
+        "<version>0.3.0</version><date>2020-01-01 00:00:00</date></program>"
+        "<sim_params><mu>  -0.25\n</mu></sim_params>"
+        "<design><layer type='DB'><dbdot><latcoord n=\"1\" m=\"2\" l=\"0\"></latcoord>"
+        "</dbdot></layer></design></siqad>");
+    // a DB moved
+    QString moved = writeProblem("moved.xml",
+        "<siqad><sim_params><mu>-0.25</mu></sim_params>"
+        "<design><layer type=\"DB\"><dbdot><latcoord n=\"1\" m=\"3\" l=\"0\"/>"
+        "</dbdot></layer></design></siqad>");
+
+    QStringList command({"@PYTHON@", "@BINPATH@/engine.py", "@PROBLEMPATH@", "@RESULTPATH@"});
+    QMap<QString, QString> params({{"mu", "-0.25"}});
+    QString key = comp::ResultCache::cacheKey(base, "SimAnneal 0.1", command, params);
+    QVERIFY(!key.isEmpty());
+
+    // stable when only the formatting or the program section changes
+    QCOMPARE(comp::ResultCache::cacheKey(base, "SimAnneal 0.1", command, params), key);
+    QCOMPARE(comp::ResultCache::cacheKey(reformatted, "SimAnneal 0.1", command, params), key);
+
+    // changes with the design, the engine, the command and the parameters
+    QVERIFY(comp::ResultCache::cacheKey(moved, "SimAnneal 0.1", command, params) != key);
+    QVERIFY(comp::ResultCache::cacheKey(base, "SimAnneal 0.2", command, params) != key);
+    QVERIFY(comp::ResultCache::cacheKey(base, "SimAnneal 0.1", command.mid(0, 3), params) != key);
+    QVERIFY(comp::ResultCache::cacheKey(base, "SimAnneal 0.1", command,
+          QMap<QString, QString>({{"mu", "-0.3"}})) != key);
+
+    // unreadable problems have no key
+    QVERIFY(comp::ResultCache::cacheKey(dir.filePath("missing.xml"), "SimAnneal 0.1",
+          command, params).isEmpty());
+  }
+
+  void testLogCapturePaging()
+  {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString log_path = dir.filePath("stdout.log");
+    const int chunk_bytes = 1024*1024;
+    const int pages_per_chunk = chunk_bytes / comp::LogCapture::page_bytes;
+    int max_log_mb = qMax(1, settings::AppSettings::instance()->get<int>("plugs/max_log_mb"));
+
+    // fill the log file with one more chunk than fits, which rotates it as
+    // a whole, then start the new log file with a short tail
+    comp::LogCapture capture(log_path);
+    int n_chunks = max_log_mb + 1;
+    for (int i=0; i<n_chunks; i++)
+      capture.append(QByteArray(chunk_bytes, 'a' + i % 26));
+    QByteArray tail("tail of the output\n");
+    capture.append(tail);
+
+    QCOMPARE(capture.filePaths(), QStringList({log_path + ".1", log_path}));
+    QCOMPARE(capture.pageCount(), n_chunks * pages_per_chunk + 1);
+
+    // pages run from the oldest output in the rotated file to the tail in
+    // the current one
+    auto chunkPage = [](int chunk)
+    {
+      return QString(int(comp::LogCapture::page_bytes), QChar('a' + chunk % 26));
+    };
+    QCOMPARE(capture.page(0), chunkPage(0));
+    QCOMPARE(capture.page(pages_per_chunk), chunkPage(1));
+    QCOMPARE(capture.page(n_chunks * pages_per_chunk - 1), chunkPage(n_chunks - 1));
+    QCOMPARE(capture.page(n_chunks * pages_per_chunk), QString(tail));
+    QVERIFY(capture.page(n_chunks * pages_per_chunk + 1).isEmpty());
+
+    // a capture of the existing log files pages through them the same way
+    comp::LogCapture reader(log_path);
+    QCOMPARE(reader.pageCount(), capture.pageCount());
+    QCOMPARE(reader.page(n_chunks * pages_per_chunk), QString(tail));
+  }
+
 };
 
 QTEST_MAIN(SiQADTests)